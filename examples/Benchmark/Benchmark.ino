@@ -0,0 +1,395 @@
+/**
+ * @file FVM/Benchmark.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2016-2017, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA  02111-1307  USA
+ *
+ * @section Description
+ * Measure the inner interpreter; nano-seconds per token for a loop
+ * of memory access and arithmetic operations, and nano-seconds per
+ * iteration for loops of stack operations and kernel operations
+ * with both C++ and threaded code. The virtual machine should be
+ * configured with trace disabled (FVM_TRACE 0), or with trace (1)
+ * for the trace filter measurement.
+ *
+ * @section Measurements
+ * Nano-seconds per token for each dispatch (FVM_DISPATCH 0, 1).
+ *
+ * Linux/x86-64 (g++ -O2)
+ * bench: 2.13, 1.25 ns
+ *
+ * Nano-seconds per token with trace enabled and filtered out; trace
+ * filter for a word that is not called (FVM_TRACE 1). Inner
+ * interpreter without and with trace.
+ *
+ * Linux/x86-64 (g++ -O2)
+ * filter: 0.92, 2.51 ns
+ *
+ * Nano-seconds per dictionary lookup of the kernel operation names
+ * below, a sketch word and a number (not found); linear search and
+ * hash index (not AVR). Loading a source file of 620K tokens with
+ * the Forth sketch takes 0.43 and 0.033 s (1.4 and 18.8 M tokens/s).
+ *
+ * Linux/x86-64 (g++ -O2)
+ * lookup: 286.78, 10.34 ns
+ *
+ * Nano-seconds per iteration for each stack cache (FVM_STACK_CACHE
+ * 1, 2). Parameter stack loads and stores per operation are 2swap
+ * 10, 6; rot 4, 2; within 9, 6.
+ *
+ * Linux/x86-64 (g++ -O2)
+ * 2swap: 9.32, 9.82 ns
+ * rot: 2.77, 2.88 ns
+ * within: 27.26, 30.21 ns
+ *
+ * Nano-seconds per iteration of a summing loop, do-sum (0 do i +
+ * loop) and for-sum (for i + next), for each loop frame access
+ * (FVM_LOOP_REG 0, 1).
+ *
+ * Linux/x86-64 (g++ -O2)
+ * do-sum: 4.44, 5.17 ns
+ * for-sum: 3.93, 4.98 ns
+ *
+ * Kernel code size and nano-seconds per iteration for each build
+ * profile (FVM_PROFILE size, balanced, speed). Iteration is argument
+ * literals, operation and drop of results. Output operations are
+ * measured with a null device. On AVR divide by 62.5 ns for cycles.
+ *
+ * Linux/x86-64 (g++ -Os, FVM.cpp text)
+ * size: 15739, 16400, 18380 bytes
+ *
+ * Linux/x86-64 (g++ -O2)
+ * (loop): 2.81, 2.42, 2.67 ns
+ * here: 9.32, 8.55, 5.94 ns
+ * nip: 21.76, 7.38, 9.18 ns
+ * dup: 11.33, 7.47, 8.92 ns
+ * ?dup: 19.76, 8.76, 9.50 ns
+ * over: 14.49, 11.38, 13.42 ns
+ * tuck: 27.48, 14.93, 13.37 ns
+ * swap: 17.27, 9.94, 11.94 ns
+ * rot: 20.15, 11.93, 15.54 ns
+ * -rot: 35.00, 17.72, 15.26 ns
+ * cells: 10.62, 6.86, 6.99 ns
+ * negate: 12.01, 6.89, 7.17 ns
+ * within: 47.50, 33.59, 11.31 ns
+ * abs: 21.22, 10.09, 7.22 ns
+ * min: 27.35, 14.30, 8.65 ns
+ * max: 42.37, 16.17, 8.67 ns
+ * 0<>: 11.36, 5.80, 6.42 ns
+ * 0<: 11.70, 5.63, 6.54 ns
+ * <>: 17.41, 12.00, 8.55 ns
+ * <: 16.06, 11.99, 8.53 ns
+ * =: 13.58, 12.16, 8.09 ns
+ * >: 12.77, 11.39, 8.76 ns
+ * decimal: 12.98, 12.48, 5.95 ns
+ * cr: 14.33, 8.60, 8.20 ns
+ * space: 9.21, 5.77, 5.93 ns
+ * spaces: 19.99, 16.12, 7.75 ns
+ * .: 41.53, 28.46, 17.31 ns
+ * .s: 67.52, 44.31, 30.33 ns
+ */
+
+#include "FVM.h"
+
+// variable x
+FVM::cell_t x = 0;
+FVM_VARIABLE(0, X, x);
+
+// : bench ( n -- ) 0 do x @ i + x ! loop ;
+FVM_COLON(1, BENCH, "bench")
+  FVM_OP(ZERO),
+  FVM_OP(DO), 9,
+    FVM_CALL(X),
+    FVM_OP(FETCH),
+    FVM_OP(I),
+    FVM_OP(PLUS),
+    FVM_CALL(X),
+    FVM_OP(STORE),
+  FVM_OP(LOOP), -7,
+  FVM_OP(HALT)
+};
+
+// Tokens per iteration; x (const) @ i + x (const) ! (loop)
+const int BENCH_TOKENS = 9;
+
+// : 2swaps ( x1 x2 x3 x4 n -- ) 0 do 2swap loop 2drop 2drop ;
+FVM_COLON(2, TWO_SWAPS, "2swaps")
+  FVM_OP(ZERO),
+  FVM_OP(DO), 4,
+    FVM_OP(TWO_SWAP),
+  FVM_OP(LOOP), -2,
+  FVM_OP(TWO_DROP),
+  FVM_OP(TWO_DROP),
+  FVM_OP(HALT)
+};
+
+// : rots ( x1 x2 x3 n -- ) 0 do rot loop 2drop drop ;
+FVM_COLON(3, ROTS, "rots")
+  FVM_OP(ZERO),
+  FVM_OP(DO), 4,
+    FVM_OP(ROT),
+  FVM_OP(LOOP), -2,
+  FVM_OP(TWO_DROP),
+  FVM_OP(DROP),
+  FVM_OP(HALT)
+};
+
+// : withins ( n1 n2 n3 n -- )
+//   0 do 2 pick 2 pick 2 pick within drop loop 2drop drop ;
+FVM_COLON(4, WITHINS, "withins")
+  FVM_OP(ZERO),
+  FVM_OP(DO), 11,
+    FVM_OP(PARAM), 2,
+    FVM_OP(PARAM), 2,
+    FVM_OP(PARAM), 2,
+    FVM_OP(WITHIN),
+    FVM_OP(DROP),
+  FVM_OP(LOOP), -9,
+  FVM_OP(TWO_DROP),
+  FVM_OP(DROP),
+  FVM_OP(HALT)
+};
+
+// : do-sum ( x n -- ) 0 do i + loop drop ;
+FVM_COLON(5, DO_SUM, "do-sum")
+  FVM_OP(ZERO),
+  FVM_OP(DO), 5,
+    FVM_OP(I),
+    FVM_OP(PLUS),
+  FVM_OP(LOOP), -3,
+  FVM_OP(DROP),
+  FVM_OP(HALT)
+};
+
+// : for-sum ( x n -- ) for i + next drop ;
+FVM_COLON(6, FOR_SUM, "for-sum")
+  FVM_OP(FOR), 5,
+    FVM_OP(I),
+    FVM_OP(PLUS),
+  FVM_OP(NEXT), -3,
+  FVM_OP(DROP),
+  FVM_OP(HALT)
+};
+
+const FVM::code_P FVM::fntab[] PROGMEM = {
+  (code_P) &X_VAR,
+  BENCH_CODE,
+  TWO_SWAPS_CODE,
+  ROTS_CODE,
+  WITHINS_CODE,
+  DO_SUM_CODE,
+  FOR_SUM_CODE
+};
+
+const str_P FVM::fnstr[] PROGMEM = {
+  (str_P) X_PSTR,
+  (str_P) BENCH_PSTR,
+  (str_P) TWO_SWAPS_PSTR,
+  (str_P) ROTS_PSTR,
+  (str_P) WITHINS_PSTR,
+  (str_P) DO_SUM_PSTR,
+  (str_P) FOR_SUM_PSTR,
+  0
+};
+
+// Number of iterations and runs per measurement
+#if defined(ARDUINO_ARCH_AVR)
+const int ITERATIONS = 1000;
+const int RUNS = 1;
+#else
+const int ITERATIONS = 30000;
+const int RUNS = 100;
+#endif
+
+// Kernel operations with C++ and threaded code (FVM_PROFILE); name,
+// number of arguments and results
+struct operation_t {
+  const char* name;
+  uint8_t args;
+  uint8_t results;
+};
+
+const operation_t OPERATIONS[] = {
+  { "here", 0, 1 },
+  { "nip", 2, 1 },
+  { "dup", 1, 2 },
+  { "?dup", 1, 2 },
+  { "over", 2, 3 },
+  { "tuck", 2, 3 },
+  { "swap", 2, 2 },
+  { "rot", 3, 3 },
+  { "-rot", 3, 3 },
+  { "cells", 1, 1 },
+  { "negate", 1, 1 },
+  { "within", 3, 1 },
+  { "abs", 1, 1 },
+  { "min", 2, 1 },
+  { "max", 2, 1 },
+  { "0<>", 1, 1 },
+  { "0<", 1, 1 },
+  { "<>", 2, 1 },
+  { "<", 2, 1 },
+  { "=", 2, 1 },
+  { ">", 2, 1 },
+  { "decimal", 0, 0 },
+  { "cr", 0, 0 },
+  { "space", 0, 0 },
+  { "spaces", 1, 0 },
+  { ".", 1, 0 },
+  { ".s", 0, 0 },
+  { 0, 0, 0 }
+};
+
+// Output stream without device; output operations are measured
+// without the cost of the device driver
+class Null : public Stream {
+public:
+  virtual size_t write(uint8_t) { return (1); }
+  virtual int available() { return (0); }
+  virtual int read() { return (-1); }
+  virtual int peek() { return (-1); }
+  virtual void flush() {}
+};
+
+Null null;
+FVM::Task<32,16> task(Serial);
+FVM::Task<32,16> optask(null);
+FVM fvm;
+
+// Threaded code buffer for operation loop
+FVM::code_t code[32];
+
+void setup()
+{
+  Serial.begin(57600);
+  while (!Serial);
+  Serial.println(F("FVM/Benchmark: started"));
+}
+
+// Run given code with number of stack elements (1, 2, 3..) and
+// iterations; return micro-seconds
+uint32_t measure(FVM::code_P code, int elements, FVM::task_t& task)
+{
+  uint32_t start = micros();
+  for (int i = 0; i < RUNS; i++) {
+    for (int j = 1; j <= elements; j++) task.push(j);
+    task.push(ITERATIONS);
+    fvm.execute(code, task);
+  }
+  return (micros() - start);
+}
+
+// Print nano-seconds per iteration of stack operation loop
+void stack(const __FlashStringHelper* name, FVM::code_P code, int elements)
+{
+  float iterations = (float) ITERATIONS * RUNS;
+  float ns = (measure(code, elements, task) * 1000.0) / iterations;
+  Serial.print(name);
+  Serial.print(F(": "));
+  Serial.print(ns);
+  Serial.println(F(" ns"));
+}
+
+// Print nano-seconds per iteration of operation loop; arguments,
+// operation and drop of results. Operation loop without operation
+// (null name) for reference
+void operation(const operation_t& op)
+{
+  // : op-loop ( n -- ) 0 do 1 2 .. op drop .. loop ;
+  FVM::code_t* dp = code;
+  *dp++ = FVM::OP_ZERO;
+  *dp++ = FVM::OP_DO;
+  FVM::code_t* offset = dp++;
+  for (int i = 1; i <= op.args; i++) {
+    *dp++ = FVM::OP_CLIT;
+    *dp++ = i;
+  }
+  if (op.name != 0) {
+    int token = fvm.lookup(op.name);
+    if (token >= FVM::CORE_MAX) *dp++ = FVM::OP_SYSCALL;
+    *dp++ = token;
+  }
+  for (int i = 0; i < (op.name != 0 ? op.results : op.args); i++)
+    *dp++ = FVM::OP_DROP;
+  *dp++ = FVM::OP_LOOP;
+  *dp = (offset + 1) - dp;
+  dp += 1;
+  *offset = dp - offset;
+  *dp = FVM::OP_HALT;
+#if defined(ARDUINO_ARCH_AVR)
+  FVM::code_P fn = (FVM::code_P) (((uint8_t*) code) + FVM::CODE_P_MAX);
+#else
+  FVM::code_P fn = code;
+#endif
+  float iterations = (float) ITERATIONS * RUNS;
+  float ns = (measure(fn, 0, optask) * 1000.0) / iterations;
+  Serial.print(op.name != 0 ? op.name : "(loop)");
+  Serial.print(F(": "));
+  Serial.print(ns);
+  Serial.println(F(" ns"));
+}
+
+// Print nano-seconds per dictionary lookup; kernel operation names,
+// sketch word and number
+void lookup()
+{
+  uint32_t start = micros();
+  int n = 0;
+  for (int i = 0; i < RUNS; i++) {
+    for (int j = 0; OPERATIONS[j].name != 0; j++, n++)
+      fvm.lookup(OPERATIONS[j].name);
+    fvm.lookup("withins");
+    fvm.lookup("1234");
+    n += 2;
+  }
+  uint32_t us = micros() - start;
+  float ns = (us * 1000.0) / n;
+  Serial.print(F("lookup: "));
+  Serial.print(ns);
+  Serial.println(F(" ns"));
+}
+
+void loop()
+{
+  float tokens = (float) BENCH_TOKENS * ITERATIONS * RUNS;
+  float ns = (measure(BENCH_CODE, 0, task) * 1000.0) / tokens;
+  Serial.print(F("bench: "));
+  Serial.print(ns);
+  Serial.println(F(" ns/token"));
+  task.trace_filter(fvm.lookup("withins"));
+  task.trace(true);
+  ns = (measure(BENCH_CODE, 0, task) * 1000.0) / tokens;
+  task.trace(false);
+  task.trace_filter(0);
+  Serial.print(F("filter: "));
+  Serial.print(ns);
+  Serial.println(F(" ns/token"));
+  lookup();
+  stack(F("2swap"), TWO_SWAPS_CODE, 4);
+  stack(F("rot"), ROTS_CODE, 3);
+  stack(F("within"), WITHINS_CODE, 3);
+  stack(F("do-sum"), DO_SUM_CODE, 1);
+  stack(F("for-sum"), FOR_SUM_CODE, 1);
+  const operation_t empty = { 0, 0, 0 };
+  operation(empty);
+  for (int i = 0; OPERATIONS[i].name != 0; i++)
+    operation(OPERATIONS[i]);
+  Serial.flush();
+  delay(100);
+}
@@ -25,6 +25,15 @@
  * Compiles forth definitions, statements and generates virtual
  * machine code (C++).
  *
+ * The compiled words may also be generated as C++ functions. Branches
+ * are translated to labels, do-loops to C++ loops with local index
+ * and limit, and calls to direct function calls. Other kernel
+ * operations are executed by the inner interpreter. The functions are
+ * called by the inner interpreter through function wrappers
+ * (FVM::func_t). Words that cannot be translated are generated as
+ * virtual machine code. The generated code requires the sketch to
+ * define the virtual machine instance, fvm.
+ *
  * @section Words
  *
  * [ ( -- ) stop compile.
@@ -40,6 +49,7 @@
  *
  * compiled-words ( -- ) print list of compiled words.
  * generate-code ( -- ) print source code for compiled words.
+ * generate-functions ( -- ) print C++ functions for compiled words.
  *
  * if ( -- addr ) start conditional block.
  * else ( addr1 -- addr ) end conditional block and start alternative.
@@ -54,6 +64,8 @@
  * do ( -- addr ) start counting iteration block.
  * loop ( addr -- ) end counting iteration block.
  * +loop ( addr -- ) counting iteration block.
+ * for ( -- addr ) start down counting iteration block.
+ * next ( addr -- ) end down counting iteration block.
  *
  * mark> ( -- addr ) mark forward branch.
  * resolve> ( addr -- ) resolve forward branch.
@@ -67,10 +79,10 @@
 #define PREFIX "WORD"
 
 /*
-: mark> ( -- addr ) here 0 c, ;
-: resolve> ( addr -- ) here over - swap c! ;
+: mark> ( -- addr ) here 1- dup c@ [ (syscall) ] literal rot c! c, here 0 c, 0 c, ;
+: resolve> ( addr -- ) here over - 2dup swap c! 8 rshift swap 1+ c! ;
 : <mark ( -- addr ) here ;
-: <resolve ( addr -- ) here - c, ;
+: <resolve ( addr -- ) here 1- dup c@ [ (syscall) ] literal rot c! c, here - dup c, 8 rshift c, ;
 : if ( -- addr ) compile (0branch) mark> ; immediate
 : then ( addr -- ) resolve> ; immediate
 : else ( addr1 -- addr2 ) compile (branch) mark> swap resolve> ; immediate
@@ -86,6 +98,16 @@
 
 FVM_COLON(0, FORWARD_MARK, "mark>")
   FVM_OP(HERE),
+  FVM_OP(ONE_MINUS),
+  FVM_OP(DUP),
+  FVM_OP(C_FETCH),
+  FVM_CLIT(FVM::OP_SYSCALL),
+  FVM_OP(ROT),
+  FVM_OP(C_STORE),
+  FVM_OP(C_COMMA),
+  FVM_OP(HERE),
+  FVM_OP(ZERO),
+  FVM_OP(C_COMMA),
   FVM_OP(ZERO),
   FVM_OP(C_COMMA),
   FVM_OP(EXIT)
@@ -93,10 +115,15 @@ FVM_COLON(0, FORWARD_MARK, "mark>")
 
 FVM_COLON(1, FORWARD_RESOLVE, "resolve>")
   FVM_OP(HERE),
-  FVM_OP(OVER),
-  FVM_OP(MINUS),
+  FVM_OP(OVER_MINUS),
+  FVM_OP(TWO_DUP),
   FVM_OP(SWAP),
   FVM_OP(C_STORE),
+  FVM_CLIT(8),
+  FVM_OP(RSHIFT),
+  FVM_OP(SWAP),
+  FVM_OP(ONE_PLUS),
+  FVM_OP(C_STORE),
   FVM_OP(EXIT)
 };
 
@@ -106,8 +133,20 @@ FVM_COLON(2, BACKWARD_MARK, "<mark")
 };
 
 FVM_COLON(3, BACKWARD_RESOLVE, "<resolve")
+  FVM_OP(HERE),
+  FVM_OP(ONE_MINUS),
+  FVM_OP(DUP),
+  FVM_OP(C_FETCH),
+  FVM_CLIT(FVM::OP_SYSCALL),
+  FVM_OP(ROT),
+  FVM_OP(C_STORE),
+  FVM_OP(C_COMMA),
   FVM_OP(HERE),
   FVM_OP(MINUS),
+  FVM_OP(DUP),
+  FVM_OP(C_COMMA),
+  FVM_CLIT(8),
+  FVM_OP(RSHIFT),
   FVM_OP(C_COMMA),
   FVM_OP(EXIT)
 };
@@ -185,17 +224,34 @@ FVM_COLON(14, PLUS_LOOP, "+loop")
   FVM_OP(EXIT)
 };
 
-FVM_SYMBOL(15, LEFT_BRACKET, "[");
-FVM_SYMBOL(16, COMMENT, "(");
-FVM_SYMBOL(17, DOT_QUOTE, ".\"");
-FVM_SYMBOL(18, LITERAL, "literal");
-FVM_SYMBOL(19, SEMICOLON, ";");
-FVM_SYMBOL(20, RIGHT_BRACKET, "]");
-FVM_SYMBOL(21, COLON, ":");
-FVM_SYMBOL(22, VARIABLE, "variable");
-FVM_SYMBOL(23, CONSTANT, "constant");
-FVM_SYMBOL(24, COMPILED_WORDS, "compiled-words");
-FVM_SYMBOL(25, GENERATE_CODE, "generate-code");
+FVM_COLON(15, FOR, "for")
+  FVM_OP(COMPILE),
+  FVM_OP(FOR),
+  FVM_CALL(FORWARD_MARK),
+  FVM_CALL(BACKWARD_MARK),
+  FVM_OP(EXIT)
+};
+
+FVM_COLON(16, NEXT, "next")
+  FVM_OP(COMPILE),
+  FVM_OP(NEXT),
+  FVM_CALL(BACKWARD_RESOLVE),
+  FVM_CALL(FORWARD_RESOLVE),
+  FVM_OP(EXIT)
+};
+
+FVM_SYMBOL(17, LEFT_BRACKET, "[");
+FVM_SYMBOL(18, COMMENT, "(");
+FVM_SYMBOL(19, DOT_QUOTE, ".\"");
+FVM_SYMBOL(20, LITERAL, "literal");
+FVM_SYMBOL(21, SEMICOLON, ";");
+FVM_SYMBOL(22, RIGHT_BRACKET, "]");
+FVM_SYMBOL(23, COLON, ":");
+FVM_SYMBOL(24, VARIABLE, "variable");
+FVM_SYMBOL(25, CONSTANT, "constant");
+FVM_SYMBOL(26, COMPILED_WORDS, "compiled-words");
+FVM_SYMBOL(27, GENERATE_CODE, "generate-code");
+FVM_SYMBOL(28, GENERATE_FUNCTIONS, "generate-functions");
 
 const FVM::code_P FVM::fntab[] PROGMEM = {
   (code_P) &FORWARD_MARK_CODE,
@@ -212,7 +268,9 @@ const FVM::code_P FVM::fntab[] PROGMEM = {
   (code_P) &REPEAT_CODE,
   (code_P) &DO_CODE,
   (code_P) &LOOP_CODE,
-  (code_P) &PLUS_LOOP_CODE
+  (code_P) &PLUS_LOOP_CODE,
+  (code_P) &FOR_CODE,
+  (code_P) &NEXT_CODE
 };
 
 const str_P FVM::fnstr[] PROGMEM = {
@@ -231,6 +289,8 @@ const str_P FVM::fnstr[] PROGMEM = {
   (str_P) DO_PSTR,
   (str_P) LOOP_PSTR,
   (str_P) PLUS_LOOP_PSTR,
+  (str_P) FOR_PSTR,
+  (str_P) NEXT_PSTR,
   (str_P) LEFT_BRACKET_PSTR,
   (str_P) COMMENT_PSTR,
   (str_P) DOT_QUOTE_PSTR,
@@ -242,6 +302,7 @@ const str_P FVM::fnstr[] PROGMEM = {
   (str_P) CONSTANT_PSTR,
   (str_P) COMPILED_WORDS_PSTR,
   (str_P) GENERATE_CODE_PSTR,
+  (str_P) GENERATE_FUNCTIONS_PSTR,
   0
 };
 
@@ -280,7 +341,7 @@ void loop()
   // Check for literal value (word not found)
   if (op < 0) {
     char* endptr;
-    int val = strtol(buffer, &endptr, task.m_base);
+    FVM::cell_t val = strtol(buffer, &endptr, task.m_base);
     if (*endptr != 0) goto error;
     if (compiling)
       fvm.literal(val);
@@ -328,6 +389,10 @@ void loop()
       generate_code(Serial);
       fvm.forget(FVM::APPLICATION_MAX);
       break;
+    case GENERATE_FUNCTIONS:
+      generate_functions(Serial);
+      fvm.forget(FVM::APPLICATION_MAX);
+      break;
     default:
       goto error;
     }
@@ -354,6 +419,7 @@ void loop()
       break;
     case SEMICOLON:
       fvm.compile(FVM::OP_EXIT);
+      fvm.optimize();
       compiling = false;
       break;
     default:
@@ -388,57 +454,139 @@ void compiled_words(Stream& ios)
   ios.println();
 }
 
+
+// Length of compiled word in dynamic dictionary
+int word_length(int nr)
+{
+  uint8_t* dp = (uint8_t*) fvm.body(nr);
+  uint8_t* next = (uint8_t*) fvm.name(nr + 1);
+  if (next == 0) next = fvm.dp();
+  return (next - dp);
+}
+
+// Value of constant in dynamic dictionary (little endian cell)
+FVM::cell_t constant_value(uint8_t* dp)
+{
+  FVM::cell_t val = 0;
+  for (int i = sizeof(val); i > 0; i--) val = (val << 8) | dp[i];
+  return (val);
+}
+
 void generate_code(Stream& ios)
 {
   const char* name;
-  uint8_t* dp;
-  int val;
 
   // Generate function name strings and code
   for (int nr = 0; ((name = fvm.name(nr)) != 0); nr++) {
-    ios.print(F("const char " PREFIX));
+    generate_name(ios, nr, name);
+    generate_body(ios, nr);
+  }
+  generate_tables(ios, false);
+}
+
+void generate_functions(Stream& ios)
+{
+  const char* name;
+
+  // Generate support code; execute kernel operation or token until
+  // halt, halt inner interpreter and function wrapper
+  ios.println(F("extern FVM fvm;"));
+  ios.println(F("static void kernel(FVM::task_t& task, int op)"));
+  ios.println(F("{"));
+  ios.println(F("  FVM::code_P* rp0 = task.m_rp0;"));
+  ios.println(F("  FVM::code_P* rp = task.m_rp;"));
+  ios.println(F("  task.m_rp0 = rp;"));
+  ios.println(F("  if (fvm.execute(op, task) > 0)"));
+  ios.println(F("    while (fvm.resume(task) > 0);"));
+  ios.println(F("  task.m_rp0 = rp0;"));
+  ios.println(F("  task.m_rp = rp;"));
+  ios.println(F("}"));
+  ios.println(F("static bool halt(FVM::task_t& task)"));
+  ios.println(F("{"));
+  ios.println(F("  static const FVM::code_t HALT_CODE[] PROGMEM = {"));
+  ios.println(F("    FVM::OP_HALT"));
+  ios.println(F("  };"));
+  ios.println(F("  task.m_rp = task.m_rp0 + 1;"));
+  ios.println(F("  *task.m_rp = HALT_CODE;"));
+  ios.println(F("  return (false);"));
+  ios.println(F("}"));
+  ios.println(F("template<bool (*fn)(FVM::task_t&)>"));
+  ios.println(F("static void function(FVM::task_t& task, void* env)"));
+  ios.println(F("{"));
+  ios.println(F("  (void) env;"));
+  ios.println(F("  fn(task);"));
+  ios.println(F("}"));
+
+  // Generate function prototypes
+  for (int nr = 0; fvm.body(nr) != 0; nr++) {
+    if (!is_native(nr)) continue;
+    ios.print(F("static bool " PREFIX));
     ios.print(nr);
-    ios.print(F("_PSTR[] PROGMEM = \""));
-    ios.print(name);
-    ios.println(F("\";"));
-    dp = (uint8_t*) fvm.body(nr);
-    switch (*dp) {
-    case FVM::OP_VAR:
-      ios.print(F("FVM::cell_t " PREFIX));
-      ios.print(nr);
-      ios.println(';');
-      ios.print(F("const FVM::var_t " PREFIX));
-      ios.print(nr);
-      ios.println(F("_VAR[] PROGMEM = {"));
-      ios.print(F("  FVM::OP_CONST, &" PREFIX));
-      ios.println(nr);
-      ios.println(F("};"));
-      break;
-    case FVM::OP_CONST:
-      val = dp[2] << 8 | dp[1];
-      ios.print(F("const FVM::const_t " PREFIX));
-      ios.print(nr);
-      ios.println(F("_CONST[] PROGMEM = {"));
-      ios.print(F("  FVM::OP_CONST, "));
-      ios.println(val);
-      ios.println(F("};"));
-      break;
-    default:
-      ios.print(F("const FVM::code_t " PREFIX));
-      ios.print(nr);
-      ios.print(F("_CODE[] PROGMEM = {\n  "));
-      uint8_t* next = (uint8_t*) fvm.name(nr + 1);
-      if (next == 0) next = fvm.dp();
-      int length = next - dp;
-      while (length) {
-	int8_t code = (int8_t) *dp++;
-	ios.print(code);
-	if (--length) ios.print(F(", "));
-      }
-      ios.println();
-      ios.println(F("};"));
+    ios.println(F("_FN(FVM::task_t& task);"));
+  }
+
+  // Generate function name strings, functions and code
+  for (int nr = 0; ((name = fvm.name(nr)) != 0); nr++) {
+    generate_name(ios, nr, name);
+    if (is_native(nr))
+      generate_function(ios, nr);
+    else
+      generate_body(ios, nr);
+  }
+  generate_tables(ios, true);
+}
+
+void generate_name(Stream& ios, int nr, const char* name)
+{
+  ios.print(F("const char " PREFIX));
+  ios.print(nr);
+  ios.print(F("_PSTR[] PROGMEM = \""));
+  ios.print(name);
+  ios.println(F("\";"));
+}
+
+void generate_body(Stream& ios, int nr)
+{
+  uint8_t* dp = (uint8_t*) fvm.body(nr);
+  switch (*dp) {
+  case FVM::OP_VAR:
+    ios.print(F("FVM::cell_t " PREFIX));
+    ios.print(nr);
+    ios.println(';');
+    ios.print(F("const FVM::var_t " PREFIX));
+    ios.print(nr);
+    ios.println(F("_VAR[] PROGMEM = {"));
+    ios.print(F("  FVM::OP_CONST, FVM_ADDRESS(&" PREFIX));
+    ios.print(nr);
+    ios.println(')');
+    ios.println(F("};"));
+    break;
+  case FVM::OP_CONST:
+    ios.print(F("const FVM::const_t " PREFIX));
+    ios.print(nr);
+    ios.println(F("_CONST[] PROGMEM = {"));
+    ios.print(F("  FVM::OP_CONST, "));
+    ios.println(constant_value(dp));
+    ios.println(F("};"));
+    break;
+  default:
+    ios.print(F("const FVM::code_t " PREFIX));
+    ios.print(nr);
+    ios.print(F("_CODE[] PROGMEM = {\n  "));
+    int length = word_length(nr);
+    while (length) {
+      int8_t code = (int8_t) *dp++;
+      ios.print(code);
+      if (--length) ios.print(F(", "));
     }
+    ios.println();
+    ios.println(F("};"));
   }
+}
+
+void generate_tables(Stream& ios, bool native)
+{
+  uint8_t* dp;
 
   // Generate function code table
   ios.println(F("const FVM::code_P FVM::fntab[] PROGMEM = {"));
@@ -453,7 +601,10 @@ void generate_code(Stream& ios)
       ios.print(F("_CONST"));
       break;
     default:
-      ios.print(F("_CODE"));
+      if (native && is_native(nr))
+	ios.print(F("_FUNC"));
+      else
+	ios.print(F("_CODE"));
     }
     ios.println(',');
   }
@@ -464,9 +615,551 @@ void generate_code(Stream& ios)
   ios.println(F("const str_P FVM::fnstr[] PROGMEM = {"));
   for (int nr = 0; fvm.body(nr) != 0; nr++) {
     ios.print(F("  (str_P) " PREFIX));
-    ios.print(nr++);
+    ios.print(nr);
     ios.println(F("_PSTR,"));
   }
   ios.println(F("  0"));
   ios.println(F("};"));
 }
+
+// Check for branch operation code; short or long offset
+bool is_branch(uint8_t op)
+{
+  return (op == FVM::OP_BRANCH
+	  || op == FVM::OP_ZERO_BRANCH
+	  || op == FVM::OP_DO
+	  || op == FVM::OP_LOOP
+	  || op == FVM::OP_PLUS_LOOP
+	  || op == FVM::OP_FOR
+	  || op == FVM::OP_NEXT);
+}
+
+// Length of token with inline operands
+int token_length(uint8_t* ip)
+{
+  switch (*ip) {
+  case FVM::OP_LIT:
+    return (3);
+  case FVM::OP_WLIT:
+    return (1 + sizeof(FVM::cell_t));
+  case FVM::OP_CLIT:
+  case FVM::OP_PARAM:
+  case FVM::OP_BRANCH:
+  case FVM::OP_ZERO_BRANCH:
+  case FVM::OP_DO:
+  case FVM::OP_LOOP:
+  case FVM::OP_PLUS_LOOP:
+  case FVM::OP_FOR:
+  case FVM::OP_NEXT:
+  case FVM::OP_CALL:
+  case FVM::OP_DUP_ZERO_BRANCH:
+  case FVM::OP_CLIT_PLUS:
+  case FVM::OP_CLIT_EQUALS:
+    return (2);
+  case FVM::OP_SYSCALL:
+    return (is_branch(ip[1]) ? 4 : 2);
+  case FVM::OP_DOT_QUOTE:
+    return (strlen((char*) ip + 1) + 2);
+  }
+  return (1);
+}
+
+// Branch target (offset in word) of short or long branch at given
+// offset
+int branch_target(uint8_t* dp, int pos)
+{
+  if (dp[pos] == FVM::OP_SYSCALL)
+    return (pos + 2 + (int16_t) (dp[pos + 3] << 8 | dp[pos + 2]));
+  return (pos + 1 + (int8_t) dp[pos + 1]);
+}
+
+// Check if given offset in word is the target of a branch (i.e. a
+// label in the generated function)
+bool is_label(int nr, int pos)
+{
+  uint8_t* dp = (uint8_t*) fvm.body(nr);
+  int length = word_length(nr);
+  for (int ix = 0; ix < length; ix += token_length(dp + ix)) {
+    uint8_t op = dp[ix];
+    if (op == FVM::OP_SYSCALL && is_branch(dp[ix + 1])) op = dp[ix + 1];
+    if ((op == FVM::OP_BRANCH
+	 || op == FVM::OP_ZERO_BRANCH
+	 || op == FVM::OP_DUP_ZERO_BRANCH)
+	&& branch_target(dp, ix) == pos)
+      return (true);
+  }
+  return (false);
+}
+
+// Check if compiled word can be generated as a function; threaded
+// code words, program memory tokens, inline strings and compile
+// are not allowed
+bool is_native(int nr)
+{
+  uint8_t* dp = (uint8_t*) fvm.body(nr);
+  int length = word_length(nr);
+  for (int ix = 0; ix < length; ix += token_length(dp + ix)) {
+    if ((int8_t) dp[ix] < 0) return (false);
+    switch (dp[ix]) {
+    case FVM::OP_SLIT:
+    case FVM::OP_VAR:
+    case FVM::OP_CONST:
+    case FVM::OP_FUNC:
+    case FVM::OP_DOES:
+    case FVM::OP_COMPILE:
+      return (false);
+    }
+  }
+  return (true);
+}
+
+// C++ statement for kernel operation, or null for execute by the
+// inner interpreter
+const __FlashStringHelper* statement(uint8_t op)
+{
+  switch (op) {
+  case FVM::OP_C_FETCH: return (F("*sp = *(uint8_t*) FVM::pointer(*sp);"));
+  case FVM::OP_C_STORE:
+    return (F("*(uint8_t*) FVM::pointer(sp[0]) = sp[-1]; sp -= 2;"));
+  case FVM::OP_FETCH: return (F("*sp = *(FVM::cell_t*) FVM::pointer(*sp);"));
+  case FVM::OP_STORE:
+    return (F("*(FVM::cell_t*) FVM::pointer(sp[0]) = sp[-1]; sp -= 2;"));
+  case FVM::OP_PLUS_STORE:
+    return (F("*(FVM::cell_t*) FVM::pointer(sp[0]) += sp[-1]; sp -= 2;"));
+  case FVM::OP_DROP: return (F("sp -= 1;"));
+  case FVM::OP_NIP: return (F("sp[-1] = sp[0]; sp -= 1;"));
+  case FVM::OP_DUP: return (F("sp[1] = sp[0]; sp += 1;"));
+  case FVM::OP_QUESTION_DUP:
+    return (F("if (*sp != 0) { sp[1] = sp[0]; sp += 1; }"));
+  case FVM::OP_OVER: return (F("sp[1] = sp[-1]; sp += 1;"));
+  case FVM::OP_TUCK:
+    return (F("sp[1] = sp[0]; sp[0] = sp[-1]; sp[-1] = sp[1]; sp += 1;"));
+  case FVM::OP_PICK: return (F("*sp = sp[-1 - *sp];"));
+  case FVM::OP_SWAP:
+    return (F("{ FVM::cell_t tmp = sp[0]; sp[0] = sp[-1]; sp[-1] = tmp; }"));
+  case FVM::OP_ROT:
+    return (F("{ FVM::cell_t tmp = sp[-2]; sp[-2] = sp[-1]; "
+	      "sp[-1] = sp[0]; sp[0] = tmp; }"));
+  case FVM::OP_MINUS_ROT:
+    return (F("{ FVM::cell_t tmp = sp[0]; sp[0] = sp[-1]; "
+	      "sp[-1] = sp[-2]; sp[-2] = tmp; }"));
+  case FVM::OP_TWO_SWAP:
+    return (F("{ FVM::cell_t tmp = sp[0]; sp[0] = sp[-2]; sp[-2] = tmp; "
+	      "tmp = sp[-1]; sp[-1] = sp[-3]; sp[-3] = tmp; }"));
+  case FVM::OP_TWO_DUP: return (F("sp[1] = sp[-1]; sp[2] = sp[0]; sp += 2;"));
+  case FVM::OP_TWO_OVER: return (F("sp[1] = sp[-3]; sp[2] = sp[-2]; sp += 2;"));
+  case FVM::OP_TWO_DROP: return (F("sp -= 2;"));
+  case FVM::OP_MINUS_TWO: return (F("*++sp = -2;"));
+  case FVM::OP_MINUS_ONE: return (F("*++sp = -1;"));
+  case FVM::OP_ZERO: return (F("*++sp = 0;"));
+  case FVM::OP_ONE: return (F("*++sp = 1;"));
+  case FVM::OP_TWO: return (F("*++sp = 2;"));
+  case FVM::OP_CELL: return (F("*++sp = sizeof(FVM::cell_t);"));
+  case FVM::OP_CELLS: return (F("*sp *= sizeof(FVM::cell_t);"));
+  case FVM::OP_BOOL: return (F("*sp = (*sp != 0) ? -1 : 0;"));
+  case FVM::OP_NOT: return (F("*sp = (*sp == 0) ? -1 : 0;"));
+  case FVM::OP_TRUE: return (F("*++sp = -1;"));
+  case FVM::OP_FALSE: return (F("*++sp = 0;"));
+  case FVM::OP_INVERT: return (F("*sp = ~*sp;"));
+  case FVM::OP_AND: return (F("sp[-1] &= sp[0]; sp -= 1;"));
+  case FVM::OP_OR: return (F("sp[-1] |= sp[0]; sp -= 1;"));
+  case FVM::OP_XOR: return (F("sp[-1] ^= sp[0]; sp -= 1;"));
+  case FVM::OP_NEGATE: return (F("*sp = -*sp;"));
+  case FVM::OP_ONE_PLUS: return (F("*sp += 1;"));
+  case FVM::OP_ONE_MINUS: return (F("*sp -= 1;"));
+  case FVM::OP_TWO_PLUS: return (F("*sp += 2;"));
+  case FVM::OP_TWO_MINUS: return (F("*sp -= 2;"));
+  case FVM::OP_TWO_STAR: return (F("*sp <<= 1;"));
+  case FVM::OP_TWO_SLASH: return (F("*sp >>= 1;"));
+  case FVM::OP_PLUS: return (F("sp[-1] += sp[0]; sp -= 1;"));
+  case FVM::OP_MINUS: return (F("sp[-1] -= sp[0]; sp -= 1;"));
+  case FVM::OP_STAR: return (F("sp[-1] *= sp[0]; sp -= 1;"));
+  case FVM::OP_LSHIFT: return (F("sp[-1] <<= sp[0]; sp -= 1;"));
+  case FVM::OP_RSHIFT: return (F("sp[-1] >>= sp[0]; sp -= 1;"));
+  case FVM::OP_ABS: return (F("if (*sp < 0) *sp = -*sp;"));
+  case FVM::OP_MIN: return (F("sp -= 1; if (sp[1] < sp[0]) sp[0] = sp[1];"));
+  case FVM::OP_MAX: return (F("sp -= 1; if (sp[1] > sp[0]) sp[0] = sp[1];"));
+  case FVM::OP_ZERO_NOT_EQUALS: return (F("*sp = (*sp != 0) ? -1 : 0;"));
+  case FVM::OP_ZERO_LESS: return (F("*sp = (*sp < 0) ? -1 : 0;"));
+  case FVM::OP_ZERO_EQUALS: return (F("*sp = (*sp == 0) ? -1 : 0;"));
+  case FVM::OP_ZERO_GREATER: return (F("*sp = (*sp > 0) ? -1 : 0;"));
+  case FVM::OP_NOT_EQUALS:
+    return (F("sp[-1] = (sp[-1] != sp[0]) ? -1 : 0; sp -= 1;"));
+  case FVM::OP_LESS:
+    return (F("sp[-1] = (sp[-1] < sp[0]) ? -1 : 0; sp -= 1;"));
+  case FVM::OP_EQUALS:
+    return (F("sp[-1] = (sp[-1] == sp[0]) ? -1 : 0; sp -= 1;"));
+  case FVM::OP_GREATER:
+    return (F("sp[-1] = (sp[-1] > sp[0]) ? -1 : 0; sp -= 1;"));
+  case FVM::OP_U_LESS:
+    return (F("sp[-1] = ((FVM::ucell_t) sp[-1] < (FVM::ucell_t) sp[0]) "
+	      "? -1 : 0; sp -= 1;"));
+  case FVM::OP_OVER_PLUS: return (F("*sp += sp[-1];"));
+  case FVM::OP_OVER_MINUS: return (F("*sp -= sp[-1];"));
+  }
+  return (0);
+}
+
+// Operation code symbol for kernel operation executed by the inner
+// interpreter, or null for unknown operation code
+#define KERNEL_NAME(name) case FVM::OP_ ## name: return (F(#name))
+const __FlashStringHelper* kernel_name(uint8_t op)
+{
+  switch (op) {
+  KERNEL_NAME(EXECUTE);
+  KERNEL_NAME(YIELD);
+  KERNEL_NAME(TRACE);
+  KERNEL_NAME(DP);
+  KERNEL_NAME(HERE);
+  KERNEL_NAME(ALLOT);
+  KERNEL_NAME(COMMA);
+  KERNEL_NAME(C_COMMA);
+  KERNEL_NAME(SP);
+  KERNEL_NAME(DEPTH);
+  KERNEL_NAME(EMPTY);
+  KERNEL_NAME(ROLL);
+  KERNEL_NAME(STAR_SLASH);
+  KERNEL_NAME(SLASH);
+  KERNEL_NAME(MOD);
+  KERNEL_NAME(SLASH_MOD);
+  KERNEL_NAME(WITHIN);
+  KERNEL_NAME(EMIT);
+  KERNEL_NAME(CR);
+  KERNEL_NAME(SPACE);
+  KERNEL_NAME(SPACES);
+  KERNEL_NAME(U_DOT);
+  KERNEL_NAME(DOT);
+  KERNEL_NAME(DOT_S);
+  KERNEL_NAME(DOT_NAME);
+  KERNEL_NAME(MICROS);
+  KERNEL_NAME(MILLIS);
+  KERNEL_NAME(DELAY);
+  KERNEL_NAME(PINMODE);
+  KERNEL_NAME(DIGITALREAD);
+  KERNEL_NAME(DIGITALWRITE);
+  KERNEL_NAME(DIGITALTOGGLE);
+  KERNEL_NAME(ANALOGREAD);
+  KERNEL_NAME(ANALOGWRITE);
+  KERNEL_NAME(LOOKUP);
+  KERNEL_NAME(TO_BODY);
+  KERNEL_NAME(WORDS);
+  KERNEL_NAME(BASE);
+  KERNEL_NAME(HEX);
+  KERNEL_NAME(DECIMAL);
+  KERNEL_NAME(QUESTION_KEY);
+  KERNEL_NAME(KEY);
+  KERNEL_NAME(CACHE);
+  KERNEL_NAME(PROFILE);
+  KERNEL_NAME(TRACE_FILTER);
+  KERNEL_NAME(QUESTION);
+  KERNEL_NAME(TYPE);
+  KERNEL_NAME(ROOM);
+  }
+  return (0);
+}
+#undef KERNEL_NAME
+
+// Print indentation
+void indent(Stream& ios, int level)
+{
+  while (level--) ios.print(' ');
+}
+
+// Print loop index (or limit) variable name for loop nesting level
+void loop_var(Stream& ios, char var, int level)
+{
+  ios.print(var);
+  ios.print(level);
+}
+
+// Print parameter stack push of loop index, return stack element
+// (r@) or value
+void push_index(Stream& ios, int level)
+{
+  ios.print(F("*++sp = "));
+  if (level > 0)
+    loop_var(ios, 'i', level);
+  else
+    ios.print(F("(intptr_t) *task.m_rp"));
+  ios.println(';');
+}
+
+void generate_function(Stream& ios, int nr)
+{
+  const int LOOP_MAX = 8;
+  uint8_t* dp = (uint8_t*) fvm.body(nr);
+  int length = word_length(nr);
+  int rs[LOOP_MAX + 1];
+  int level = 0;
+  int r = 0;
+  int m;
+
+  // Generate function; parameter stack pointer in local variable,
+  // loop index and limit in block local variables
+  ios.print(F("static bool " PREFIX));
+  ios.print(nr);
+  ios.println(F("_FN(FVM::task_t& task)"));
+  ios.println('{');
+  ios.println(F("  FVM::cell_t* sp = task.m_sp;"));
+  rs[0] = 0;
+  for (int ix = 0; ix < length; ix += token_length(dp + ix)) {
+    uint8_t op = dp[ix];
+    bool is_long = (op == FVM::OP_SYSCALL && is_branch(dp[ix + 1]));
+    int col = 2 + level * 4;
+    if (is_label(nr, ix)) {
+      indent(ios, col - 2);
+      ios.print('L');
+      ios.print(ix);
+      ios.println(F(": ;"));
+    }
+    if (is_long) op = dp[ix + 1];
+    switch (op) {
+    case FVM::OP_EXIT:
+    case FVM::OP_ZERO_EXIT:
+    case FVM::OP_HALT:
+      indent(ios, col);
+      if (op == FVM::OP_ZERO_EXIT) {
+	ios.println(F("if (*sp-- == 0) {"));
+	indent(ios, col += 2);
+      }
+      ios.println(F("task.m_sp = sp;"));
+      indent(ios, col);
+      if (op == FVM::OP_HALT)
+	ios.println(F("return (halt(task));"));
+      else
+	ios.println(F("return (true);"));
+      if (op == FVM::OP_ZERO_EXIT) {
+	indent(ios, col - 2);
+	ios.println('}');
+      }
+      break;
+    case FVM::OP_NOOP:
+      break;
+    case FVM::OP_LIT:
+    case FVM::OP_CLIT:
+    case FVM::OP_WLIT:
+      indent(ios, col);
+      ios.print(F("*++sp = "));
+      if (op == FVM::OP_LIT)
+	ios.print((int16_t) (dp[ix + 2] << 8 | dp[ix + 1]));
+      else if (op == FVM::OP_WLIT)
+	ios.print(constant_value(dp + ix));
+      else
+	ios.print((int8_t) dp[ix + 1]);
+      ios.println(';');
+      break;
+    case FVM::OP_PARAM:
+      indent(ios, col);
+      ios.print(F("sp[1] = sp["));
+      ios.print(-dp[ix + 1]);
+      ios.println(F("]; sp += 1;"));
+      break;
+    case FVM::OP_CLIT_PLUS:
+      indent(ios, col);
+      ios.print(F("*sp += "));
+      ios.print((int8_t) dp[ix + 1]);
+      ios.println(';');
+      break;
+    case FVM::OP_CLIT_EQUALS:
+      indent(ios, col);
+      ios.print(F("*sp = (*sp == "));
+      ios.print((int8_t) dp[ix + 1]);
+      ios.println(F(") ? -1 : 0;"));
+      break;
+    case FVM::OP_BRANCH:
+    case FVM::OP_ZERO_BRANCH:
+    case FVM::OP_DUP_ZERO_BRANCH:
+      indent(ios, col);
+      if (op == FVM::OP_ZERO_BRANCH)
+	ios.print(F("if (*sp-- == 0) "));
+      else if (op == FVM::OP_DUP_ZERO_BRANCH)
+	ios.print(F("if (*sp == 0) "));
+      ios.print(F("goto L"));
+      ios.print(branch_target(dp, ix));
+      ios.println(';');
+      break;
+    case FVM::OP_DO:
+    case FVM::OP_FOR:
+      if (level == LOOP_MAX) goto error;
+      level += 1;
+      rs[level] = r;
+      indent(ios, col);
+      ios.println('{');
+      indent(ios, col + 2);
+      ios.print(F("FVM::cell_t "));
+      loop_var(ios, 'i', level);
+      if (op == FVM::OP_FOR)
+	ios.println(F(" = *sp-- - 1;"));
+      else
+	ios.println(F(" = *sp--;"));
+      indent(ios, col + 2);
+      ios.print(F("FVM::cell_t "));
+      loop_var(ios, 'n', level);
+      if (op == FVM::OP_FOR)
+	ios.println(F(" = 0;"));
+      else
+	ios.println(F(" = *sp--;"));
+      indent(ios, col + 2);
+      ios.print(F("if ("));
+      loop_var(ios, 'i', level);
+      ios.print(op == FVM::OP_FOR ? F(" >= ") : F(" < "));
+      loop_var(ios, 'n', level);
+      ios.println(F(") do {"));
+      break;
+    case FVM::OP_LOOP:
+    case FVM::OP_PLUS_LOOP:
+    case FVM::OP_NEXT:
+      if (level == 0) goto error;
+      indent(ios, col - 2);
+      ios.print(F("} while ("));
+      if (op != FVM::OP_NEXT) ios.print(F("(FVM::ucell_t) "));
+      if (op == FVM::OP_LOOP) {
+	ios.print(F("++"));
+	loop_var(ios, 'i', level);
+      }
+      else if (op == FVM::OP_NEXT) {
+	ios.print(F("--"));
+	loop_var(ios, 'i', level);
+      }
+      else {
+	ios.print('(');
+	loop_var(ios, 'i', level);
+	ios.print(F(" += *sp--)"));
+      }
+      if (op == FVM::OP_NEXT) {
+	ios.print(F(" >= "));
+	loop_var(ios, 'n', level);
+      }
+      else {
+	ios.print(F(" < (FVM::ucell_t) "));
+	loop_var(ios, 'n', level);
+      }
+      ios.println(F(");"));
+      indent(ios, col - 4);
+      ios.println('}');
+      level -= 1;
+      break;
+    case FVM::OP_I:
+      indent(ios, col);
+      push_index(ios, level);
+      break;
+    case FVM::OP_J:
+      indent(ios, col);
+      push_index(ios, level - 1);
+      break;
+    case FVM::OP_LEAVE:
+      if (level == 0) goto error;
+      indent(ios, col);
+      loop_var(ios, 'i', level);
+      ios.print(F(" = "));
+      loop_var(ios, 'n', level);
+      ios.println(';');
+      break;
+    case FVM::OP_TO_R:
+      indent(ios, col);
+      ios.println(F("*++task.m_rp = (FVM::code_P) (intptr_t) *sp--;"));
+      r += 1;
+      break;
+    case FVM::OP_R_FROM:
+      indent(ios, col);
+      ios.println(F("*++sp = (intptr_t) *task.m_rp--;"));
+      r -= 1;
+      break;
+    case FVM::OP_R_FETCH:
+      indent(ios, col);
+      push_index(ios, rs[level] == r ? level : 0);
+      break;
+    case FVM::OP_R_FETCH_PLUS:
+    case FVM::OP_R_FETCH_MINUS:
+      indent(ios, col);
+      ios.print(op == FVM::OP_R_FETCH_PLUS ? F("*sp += ") : F("*sp -= "));
+      if (level > 0 && rs[level] == r)
+	loop_var(ios, 'i', level);
+      else
+	ios.print(F("(intptr_t) *task.m_rp"));
+      ios.println(';');
+      break;
+    case FVM::OP_I_FETCH:
+      indent(ios, col);
+      ios.print(F("*++sp = *(FVM::cell_t*) FVM::pointer("));
+      if (level > 0)
+	loop_var(ios, 'i', level);
+      else
+	ios.print(F("(intptr_t) *task.m_rp"));
+      ios.println(F(");"));
+      break;
+    case FVM::OP_DOT_QUOTE:
+      indent(ios, col);
+      ios.print(F("task.m_ios.print(F(\""));
+      for (char* s = (char*) dp + ix + 1; *s; s++) {
+	if (*s == '\"' || *s == '\\') ios.print('\\');
+	ios.print(*s);
+      }
+      ios.println(F("\"));"));
+      break;
+    case FVM::OP_CALL:
+      m = dp[ix + 1];
+      indent(ios, col);
+      switch (*fvm.body(m)) {
+      case FVM::OP_VAR:
+	ios.print(F("*++sp = FVM::address(&" PREFIX));
+	ios.print(m);
+	ios.println(F(");"));
+	break;
+      case FVM::OP_CONST:
+	ios.print(F("*++sp = "));
+	ios.print(constant_value((uint8_t*) fvm.body(m)));
+	ios.println(';');
+	break;
+      default:
+	ios.println(F("task.m_sp = sp;"));
+	indent(ios, col);
+	if (is_native(m)) {
+	  ios.print(F("if (!" PREFIX));
+	  ios.print(m);
+	  ios.println(F("_FN(task)) return (false);"));
+	}
+	else {
+	  ios.print(F("kernel(task, FVM::KERNEL_MAX + "));
+	  ios.print(m);
+	  ios.println(F(");"));
+	}
+	indent(ios, col);
+	ios.println(F("sp = task.m_sp;"));
+      }
+      break;
+    default:
+      if (op == FVM::OP_SYSCALL) op = dp[ix + 1];
+      const __FlashStringHelper* s = statement(op);
+      if (s == 0) {
+	indent(ios, col);
+	ios.println(F("task.m_sp = sp;"));
+	indent(ios, col);
+	ios.print(F("kernel(task, "));
+	const __FlashStringHelper* name = kernel_name(op);
+	if (name != 0) {
+	  ios.print(F("FVM::OP_"));
+	  ios.print(name);
+	}
+	else
+	  ios.print(op);
+	ios.println(F(");"));
+	indent(ios, col);
+	ios.println(F("sp = task.m_sp;"));
+      }
+      else {
+	indent(ios, col);
+	ios.println(s);
+      }
+    }
+  }
+ error:
+  ios.println('}');
+
+  // Generate function wrapper for the inner interpreter
+  ios.print(F("const FVM::func_t " PREFIX));
+  ios.print(nr);
+  ios.print(F("_FUNC PROGMEM = { FVM::OP_FUNC, function<" PREFIX));
+  ios.print(nr);
+  ios.println(F("_FN>, 0 };"));
+}
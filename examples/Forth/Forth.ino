@@ -61,29 +61,53 @@
  * do ( high low -- ) start counting iteration block.
  * loop ( -- ) end counting iteration block.
  * +loop ( n -- ) counting iteration block.
+ * for ( n -- ) start down counting iteration block.
+ * next ( -- ) end down counting iteration block.
  *
  * mark> ( -- addr ) mark forward branch.
  * resolve> ( addr -- ) resolve forward branch.
  * <mark ( -- addr ) mark backward branch.
  * <resolve ( addr -- ) resolve backward branch.
+ *
+ * @section Test
+ * Number conversion after a base change in the same line; the
+ * pending line is run before the number is converted.
+ *
+ * 16 base ! ff . decimal        => FF [0]:
+ * : octal 8 base ! ; octal 17 . decimal        => 17 [0]:
  */
 
 #include "FVM.h"
 
-// : mark> ( -- addr ) here 0 c, ;
+// : mark> ( -- addr ) here 1- dup c@ [ (syscall) ] literal rot c! c, here 0 c, 0 c, ;
 FVM_COLON(0, FORWARD_MARK, "mark>")
   FVM_OP(HERE),
+  FVM_OP(ONE_MINUS),
+  FVM_OP(DUP),
+  FVM_OP(C_FETCH),
+  FVM_CLIT(FVM::OP_SYSCALL),
+  FVM_OP(ROT),
+  FVM_OP(C_STORE),
+  FVM_OP(C_COMMA),
+  FVM_OP(HERE),
+  FVM_OP(ZERO),
+  FVM_OP(C_COMMA),
   FVM_OP(ZERO),
   FVM_OP(C_COMMA),
   FVM_OP(EXIT)
 };
 
-// : resolve> ( addr -- ) here over - swap c! ;
+// : resolve> ( addr -- ) here over - 2dup swap c! 8 rshift swap 1+ c! ;
 FVM_COLON(1, FORWARD_RESOLVE, "resolve>")
   FVM_OP(HERE),
-  FVM_OP(OVER),
-  FVM_OP(MINUS),
+  FVM_OP(OVER_MINUS),
+  FVM_OP(TWO_DUP),
+  FVM_OP(SWAP),
+  FVM_OP(C_STORE),
+  FVM_CLIT(8),
+  FVM_OP(RSHIFT),
   FVM_OP(SWAP),
+  FVM_OP(ONE_PLUS),
   FVM_OP(C_STORE),
   FVM_OP(EXIT)
 };
@@ -94,10 +118,22 @@ FVM_COLON(2, BACKWARD_MARK, "<mark")
   FVM_OP(EXIT)
 };
 
-// : <resolve ( addr -- ) here - c, ;
+// : <resolve ( addr -- ) here 1- dup c@ [ (syscall) ] literal rot c! c, here - dup c, 8 rshift c, ;
 FVM_COLON(3, BACKWARD_RESOLVE, "<resolve")
+  FVM_OP(HERE),
+  FVM_OP(ONE_MINUS),
+  FVM_OP(DUP),
+  FVM_OP(C_FETCH),
+  FVM_CLIT(FVM::OP_SYSCALL),
+  FVM_OP(ROT),
+  FVM_OP(C_STORE),
+  FVM_OP(C_COMMA),
   FVM_OP(HERE),
   FVM_OP(MINUS),
+  FVM_OP(DUP),
+  FVM_OP(C_COMMA),
+  FVM_CLIT(8),
+  FVM_OP(RSHIFT),
   FVM_OP(C_COMMA),
   FVM_OP(EXIT)
 };
@@ -186,20 +222,38 @@ FVM_COLON(14, PLUS_LOOP, "+loop")
   FVM_OP(EXIT)
 };
 
+// : for ( -- addr1 addr2 ) compile (for) mark> <mark ; immediate
+FVM_COLON(15, FOR, "for")
+  FVM_OP(COMPILE),
+  FVM_OP(FOR),
+  FVM_CALL(FORWARD_MARK),
+  FVM_CALL(BACKWARD_MARK),
+  FVM_OP(EXIT)
+};
+
+// : next ( addr1 addr2 -- ) compile (next) <resolve resolve> ; immediate
+FVM_COLON(16, NEXT, "next")
+  FVM_OP(COMPILE),
+  FVM_OP(NEXT),
+  FVM_CALL(BACKWARD_RESOLVE),
+  FVM_CALL(FORWARD_RESOLVE),
+  FVM_OP(EXIT)
+};
+
 // Sketch dispatched symbols
-FVM_SYMBOL(15, LEFT_BRACKET, "[");
-FVM_SYMBOL(16, COMMENT, "(");
-FVM_SYMBOL(17, DOT_QUOTE, ".\"");
-FVM_SYMBOL(18, LITERAL, "literal");
-FVM_SYMBOL(19, SEMICOLON, ";");
-FVM_SYMBOL(20, RIGHT_BRACKET, "]");
-FVM_SYMBOL(21, COLON, ":");
-FVM_SYMBOL(22, CREATE, "create");
-FVM_SYMBOL(23, VARIABLE, "variable");
-FVM_SYMBOL(24, CONSTANT, "constant");
-FVM_SYMBOL(25, WORDS, "words");
-FVM_SYMBOL(26, FORGET, "forget");
-FVM_SYMBOL(27, TICK, "\'");
+FVM_SYMBOL(17, LEFT_BRACKET, "[");
+FVM_SYMBOL(18, COMMENT, "(");
+FVM_SYMBOL(19, DOT_QUOTE, ".\"");
+FVM_SYMBOL(20, LITERAL, "literal");
+FVM_SYMBOL(21, SEMICOLON, ";");
+FVM_SYMBOL(22, RIGHT_BRACKET, "]");
+FVM_SYMBOL(23, COLON, ":");
+FVM_SYMBOL(24, CREATE, "create");
+FVM_SYMBOL(25, VARIABLE, "variable");
+FVM_SYMBOL(26, CONSTANT, "constant");
+FVM_SYMBOL(27, WORDS, "words");
+FVM_SYMBOL(28, FORGET, "forget");
+FVM_SYMBOL(29, TICK, "\'");
 
 const FVM::code_P FVM::fntab[] PROGMEM = {
   FORWARD_MARK_CODE,
@@ -216,7 +270,9 @@ const FVM::code_P FVM::fntab[] PROGMEM = {
   REPEAT_CODE,
   DO_CODE,
   LOOP_CODE,
-  PLUS_LOOP_CODE
+  PLUS_LOOP_CODE,
+  FOR_CODE,
+  NEXT_CODE
 };
 
 const str_P FVM::fnstr[] PROGMEM = {
@@ -235,6 +291,8 @@ const str_P FVM::fnstr[] PROGMEM = {
   (str_P) DO_PSTR,
   (str_P) LOOP_PSTR,
   (str_P) PLUS_LOOP_PSTR,
+  (str_P) FOR_PSTR,
+  (str_P) NEXT_PSTR,
   (str_P) LEFT_BRACKET_PSTR,
   (str_P) COMMENT_PSTR,
   (str_P) DOT_QUOTE_PSTR,
@@ -255,6 +313,9 @@ const str_P FVM::fnstr[] PROGMEM = {
 #if defined(ARDUINO_ARCH_AVR)
 const int DATA_MAX = (RAMEND - RAMSTART - 1024);
 const int DICT_MAX = (RAMEND - RAMSTART) / 64;
+#elif (FVM_CELL == 16)
+const int DATA_MAX = 8 * 1024;
+const int DICT_MAX = 128;
 #else
 const int DATA_MAX = 32 * 1024;
 const int DICT_MAX = 128;
@@ -263,7 +324,7 @@ const int DICT_MAX = 128;
 // Forth virtual machine, data area and task
 uint8_t data[DATA_MAX];
 FVM fvm(data, DATA_MAX, DICT_MAX);
-FVM::Task<64,32> task(Serial);
+FVM::Task<64,32,64> task(Serial);
 
 // Interpreter state
 int compiling = false;
@@ -278,7 +339,8 @@ void setup()
 void loop()
 {
   char buffer[32];
-  int op, val;
+  FVM::cell_t val;
+  int op;
   char c;
 
   // Scan and lookup word
@@ -288,12 +350,13 @@ void loop()
   // Check for literal value (word not found)
   if (op < 0) {
     char* endptr;
+    if (!compiling) fvm.run_line_base(task);
     val = strtol(buffer, &endptr, task.m_base == 10 ? 0 : task.m_base);
     if (*endptr != 0) goto error;
     if (compiling)
       fvm.literal(val);
     else
-      task.push(val);
+      fvm.line_literal(val, task);
   }
 
   // Check for kernel words; compile or execute
@@ -302,7 +365,7 @@ void loop()
       fvm.compile(op);
     }
     else {
-      execute(op);
+      fvm.line(op, task);
     }
   }
 
@@ -313,6 +376,7 @@ void loop()
 
   // Check special forms; Interactive mode
   else if (!compiling) {
+    if (op < FVM::APPLICATION_MAX) fvm.run_line(task);
     switch (op) {
     case RIGHT_BRACKET:
       compiling = true;
@@ -367,7 +431,7 @@ void loop()
       break;
     default:
       if (op < FVM::APPLICATION_MAX) goto error;
-      execute(op);
+      fvm.line(op, task);
     }
   }
 
@@ -392,6 +456,7 @@ void loop()
       break;
     case SEMICOLON:
       fvm.compile(FVM::OP_EXIT);
+      fvm.optimize();
       compiling = false;
       break;
     default:
@@ -402,7 +467,9 @@ void loop()
     }
   }
 
-  // Prompt on end of line
+  // Run line on end of line or input; prompt on end of line
+  if (!compiling && (c == '\n' || !Serial.available()))
+    fvm.run_line(task);
   if (c == '\n' && !compiling) {
     if (task.trace())
       Serial.println(F(" ok"));
@@ -412,6 +479,7 @@ void loop()
   return;
 
  error:
+  fvm.run_line(task);
   Serial.print(buffer);
   Serial.println(F(" ??"));
   compiling = false;
@@ -95,7 +95,7 @@ void numbers(FVM::task_t &task, void* env)
   task.push(1);
   task.push(2);
   task.push(3);
-  task.push((FVM::cell_t) env);
+  task.push(FVM::address(env));
   task.push(task.depth());
 }
 FVM_FUNCTION(7, NUMBERS, numbers, pad);
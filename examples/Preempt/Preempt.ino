@@ -0,0 +1,140 @@
+/**
+ * @file FVM/Preempt.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2017, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA  02111-1307  USA
+ *
+ * @section Description
+ * Preemption of CPU-bound tasks with the Forth Virtual Machine (FVM)
+ * instruction budget. The tasks never yield. Measure iterations per
+ * second, the average and worst-case time between task switches
+ * (resume), and the worst-case time for a round of all tasks, for a
+ * number of budgets. The worst-case includes interrupts and host
+ * scheduling. The virtual machine must be configured with
+ * instruction budget (FVM_FUEL 1 in FVM.h).
+ *
+ * @section Measurements
+ * Budget, million iterations per second, average/worst-case
+ * micro-seconds per switch and worst-case per round with 100 tasks.
+ * Each iteration is two calls and a backward branch.
+ *
+ * Linux/x86-64 (g++ -O2, FVM_TRACE 0, one shared core)
+ * budget: 10, 27.3 M/s, 0.12/2433 us, 2446 us
+ * budget: 100, 44.4 M/s, 0.75/1614 us, 1698 us
+ * budget: 1000, 50.8 M/s, 6.56/4056 us, 4819 us
+ * budget: 10000, 46.5 M/s, 71.64/5960 us, 16396 us
+ */
+
+#include <FVM.h>
+
+#if (FVM_FUEL == 0)
+#error "Preempt requires FVM_FUEL 1"
+#endif
+
+// variable count
+FVM::cell_t count = 0;
+FVM_VARIABLE(0, COUNT, count);
+
+// : work ( -- ) 1 count +! ;
+FVM_COLON(1, WORK, "work")
+  FVM_OP(ONE),
+  FVM_CALL(COUNT),
+  FVM_OP(PLUS_STORE),
+  FVM_OP(EXIT)
+};
+
+// : spin ( -- ) begin work again ;
+FVM_COLON(2, SPIN, "spin")
+    FVM_CALL(WORK),
+  FVM_OP(BRANCH), -2,
+  FVM_OP(EXIT)
+};
+
+const FVM::code_P FVM::fntab[] PROGMEM = {
+  (code_P) &COUNT_VAR,
+  WORK_CODE,
+  SPIN_CODE
+};
+
+const str_P FVM::fnstr[] PROGMEM = {
+  (str_P) COUNT_PSTR,
+  (str_P) WORK_PSTR,
+  (str_P) SPIN_PSTR,
+  0
+};
+
+// Number of tasks, budgets and measurement period (ms)
+#if defined(ARDUINO_ARCH_AVR)
+const int TASKS = 8;
+#else
+const int TASKS = 100;
+#endif
+const uint32_t BUDGET[] = { 10, 100, 1000, 10000 };
+const uint32_t PERIOD = 2000;
+
+FVM fvm;
+FVM::task_t* task[TASKS];
+
+void setup()
+{
+  Serial.begin(57600);
+  while (!Serial);
+  Serial.println(F("FVM/Preempt: started"));
+
+  for (int i = 0; i < TASKS; i++)
+    task[i] = new FVM::Task<8,8>(Serial, SPIN_CODE);
+}
+
+void loop()
+{
+  for (size_t b = 0; b < sizeof(BUDGET) / sizeof(BUDGET[0]); b++) {
+    // Resume all tasks in order with budget; measure switch and
+    // round time
+    uint32_t budget = BUDGET[b];
+    uint32_t switch_max = 0;
+    uint32_t round_max = 0;
+    uint32_t resumes = 0;
+    uint32_t start = millis();
+    uint32_t ms;
+    count = 0;
+    while ((ms = millis() - start) < PERIOD) {
+      uint32_t round = micros();
+      for (int i = 0; i < TASKS; i++) {
+	uint32_t now = micros();
+	fvm.resume(*task[i], budget);
+	now = micros() - now;
+	if (now > switch_max) switch_max = now;
+      }
+      round = micros() - round;
+      if (round > round_max) round_max = round;
+      resumes += TASKS;
+    }
+    Serial.print(F("budget: "));
+    Serial.print(budget);
+    Serial.print(F(", "));
+    Serial.print(((FVM::ucell_t) count) / (ms * 1000.0), 1);
+    Serial.print(F(" M/s, "));
+    Serial.print((ms * 1000.0) / resumes, 2);
+    Serial.print(F("/"));
+    Serial.print(switch_max);
+    Serial.print(F(" us, "));
+    Serial.print(round_max);
+    Serial.println(F(" us"));
+  }
+}
@@ -0,0 +1,242 @@
+/**
+ * @file FVM/Scheduler.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2017, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA  02111-1307  USA
+ *
+ * @section Description
+ * Multiple blink tasks with the Forth Virtual Machine (FVM) task
+ * scheduler. Compare resumes per second and processor load for a
+ * round-robin resume of all tasks and the scheduler. Blocked tasks
+ * in delay are not resumed by the scheduler and the idle time is
+ * used for sleep. On Linux a number of echo sessions on socket pairs
+ * wait in key and are woken by epoll when input is available.
+ *
+ * @section Measurements
+ * Resumes per second and processor load with 1000 tasks (delay
+ * 500..999 ms).
+ *
+ * Linux/x86-64 (g++ -O2)
+ * round-robin: 22439000 resumes/s, 100.0% cpu
+ * scheduler: 1385 resumes/s, 0.2% cpu
+ *
+ * Echo sessions with 256 sessions and one character per session
+ * every 100 ms.
+ *
+ * Linux/x86-64 (g++ -O2)
+ * sessions: 2560 echo/s
+ * scheduler: 3945 resumes/s, 1.7% cpu
+ */
+
+#include <FVM.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#endif
+
+// : blink ( ms pin -- )
+//   begin
+//     dup digitaltoggle
+//     over delay
+//   again ;
+FVM_COLON(0, BLINK, "blink")
+    FVM_OP(DUP),
+    FVM_OP(DIGITALTOGGLE),
+    FVM_OP(OVER),
+    FVM_OP(DELAY),
+  FVM_OP(BRANCH), -5,
+  FVM_OP(EXIT)
+};
+
+// : session ( -- ) begin key emit again ;
+FVM_COLON(1, SESSION, "session")
+    FVM_SYSCALL(KEY),
+    FVM_OP(EMIT),
+  FVM_OP(BRANCH), -4,
+  FVM_OP(EXIT)
+};
+
+const FVM::code_P FVM::fntab[] PROGMEM = {
+  BLINK_CODE,
+  SESSION_CODE
+};
+
+const str_P FVM::fnstr[] PROGMEM = {
+  (str_P) BLINK_PSTR,
+  (str_P) SESSION_PSTR,
+  0
+};
+
+// Number of tasks and measurement period (ms)
+#if defined(ARDUINO_ARCH_AVR)
+const int TASKS = 8;
+#else
+const int TASKS = 1000;
+#endif
+const uint32_t PERIOD = 5000;
+
+#if defined(__linux__)
+// Number of echo sessions and input period (ms)
+const int SESSIONS = 256;
+const uint32_t INPUT_PERIOD = 100;
+
+// Stream on non-blocking file descriptor
+class FdStream : public Stream {
+public:
+  FdStream(int fd) : m_fd(fd), m_peek(-1) {}
+
+  virtual size_t write(uint8_t c)
+  {
+    return (::write(m_fd, &c, 1) == 1);
+  }
+
+  virtual int available()
+  {
+    uint8_t c;
+    if (m_peek < 0 && ::read(m_fd, &c, 1) == 1) m_peek = c;
+    return (m_peek >= 0);
+  }
+
+  virtual int read()
+  {
+    int c = peek();
+    m_peek = -1;
+    return (c);
+  }
+
+  virtual int peek()
+  {
+    available();
+    return (m_peek);
+  }
+
+  virtual void flush() {}
+
+protected:
+  int m_fd;
+  int m_peek;
+};
+
+// Session peer file descriptors
+int peer[SESSIONS];
+#endif
+
+// Scheduler with idle time accumulation
+class IdleScheduler : public FVM::Scheduler {
+public:
+  IdleScheduler(FVM& fvm) : FVM::Scheduler(fvm), m_idle(0) {}
+
+  virtual void idle(uint32_t ms)
+  {
+    uint32_t start = millis();
+    FVM::Scheduler::idle(ms);
+    m_idle += millis() - start;
+  }
+
+  uint32_t m_idle;
+};
+
+FVM fvm;
+IdleScheduler scheduler(fvm);
+FVM::task_t* task[TASKS];
+
+// Print resumes per second and processor load for the period
+void print(const __FlashStringHelper* name, uint32_t resumes,
+	   uint32_t ms, uint32_t idle)
+{
+  Serial.print(name);
+  Serial.print(F(": "));
+  Serial.print((resumes * 1000.0) / ms, 0);
+  Serial.print(F(" resumes/s, "));
+  Serial.print((100.0 * (ms - idle)) / ms, 1);
+  Serial.println(F("% cpu"));
+}
+
+void setup()
+{
+  Serial.begin(57600);
+  while (!Serial);
+  Serial.println(F("FVM/Scheduler: started"));
+
+  // ms pin blink
+  for (int i = 0; i < TASKS; i++) {
+    task[i] = new FVM::Task<16,8>(Serial, BLINK_CODE);
+    task[i]->push(500 + (i % 500));
+    task[i]->push(i % 16);
+  }
+
+  // Resume all tasks in order
+  uint32_t resumes = 0;
+  uint32_t start = millis();
+  uint32_t ms;
+  while ((ms = millis() - start) < PERIOD) {
+    for (int i = 0; i < TASKS; i++) fvm.resume(*task[i]);
+    resumes += TASKS;
+  }
+  print(F("round-robin"), resumes, ms, 0);
+
+  for (int i = 0; i < TASKS; i++) scheduler.add(*task[i]);
+
+#if defined(__linux__)
+  // Echo sessions; task waits in key for socket input
+  for (int i = 0; i < SESSIONS; i++) {
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    peer[i] = sv[1];
+    FdStream* ios = new FdStream(sv[0]);
+    scheduler.add(*new FVM::Task<16,8>(*ios, SESSION_CODE), sv[0]);
+  }
+#endif
+}
+
+void loop()
+{
+  // Resume ready tasks with the scheduler
+  uint32_t resumes = 0;
+  uint32_t start = millis();
+  uint32_t ms;
+  scheduler.m_idle = 0;
+#if defined(__linux__)
+  uint32_t input = start - INPUT_PERIOD;
+  uint32_t echos = 0;
+  char c;
+  while ((ms = millis() - start) < PERIOD) {
+    // Count echoed characters and write a character to each session
+    if (millis() - input >= INPUT_PERIOD) {
+      input += INPUT_PERIOD;
+      for (int i = 0; i < SESSIONS; i++) {
+	while (read(peer[i], &c, 1) == 1) echos += 1;
+	write(peer[i], "x", 1);
+      }
+    }
+    resumes += scheduler.run();
+  }
+  Serial.print(F("sessions: "));
+  Serial.print((echos * 1000.0) / ms, 0);
+  Serial.println(F(" echo/s"));
+#else
+  while ((ms = millis() - start) < PERIOD)
+    resumes += scheduler.run();
+#endif
+  print(F("scheduler"), resumes, ms, scheduler.m_idle);
+}
@@ -46,11 +46,11 @@ const FVM::code_t WORD0_CODE[] PROGMEM = {
 };
 const char WORD1_PSTR[] PROGMEM = "test1";
 const FVM::code_t WORD1_CODE[] PROGMEM = {
-  60, 45, 74, 45, 3, 9, 99, 11, 2, 20, 10, -10, 0
+  60, 45, 74, 45, 109, 9, 11, 2, 20, 10, -9, 0
 };
 const char WORD2_PSTR[] PROGMEM = "test2";
 const FVM::code_t WORD2_CODE[] PROGMEM = {
-  60, 45, 74, 45, 3, 9, 99, 11, -7, 20, 0
+  60, 45, 74, 45, 109, 9, 11, -6, 20, 0
 };
 const char WORD3_PSTR[] PROGMEM = "test3";
 const FVM::code_t WORD3_CODE[] PROGMEM = {
@@ -66,7 +66,7 @@ const FVM::code_t WORD5_CODE[] PROGMEM = {
 };
 const char WORD6_PSTR[] PROGMEM = "test6";
 const FVM::code_t WORD6_CODE[] PROGMEM = {
-  3, 10, 60, 12, 11, 13, 13, 3, 5, 99, 11, 2, 15, 16, -9, 20, 0
+  3, 10, 60, 12, 10, 13, 13, 109, 5, 11, 2, 15, 16, -8, 20, 0
 };
 const char WORD7_PSTR[] PROGMEM = "test7";
 const FVM::code_t WORD7_CODE[] PROGMEM = {
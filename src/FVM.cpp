@@ -23,6 +23,21 @@
 
 #include "FVM.h"
 
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#if defined(__linux__)
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 /**
  * Enable threaded code in data memory.
  * 0: Program memory only.
@@ -31,13 +46,44 @@
 #define FVM_THREADING 1
 
 /**
- * Enable symbolic trace of virtual machine instruction cycle.
+ * Enable symbolic trace of virtual machine instruction cycle. The
+ * inner interpreter is compiled with and without trace. The task
+ * trace mode selects the inner interpreter on resume and when
+ * changed (trace). On AVR only the inner interpreter with trace is
+ * used and trace mode is checked per instruction (size).
  * 0: No trace.
  * 1: Print indented operation code and stack contents.
  * 2: Print execute time, instruction pointer, return stack depth,
  * operation code and stack contents.
+ * 3: Write binary trace record (task, instruction pointer, token,
+ * stack depths, top of stack and micro-seconds) to ring buffer (not
+ * AVR). Decode with FVM::print_trace().
  */
+#if !defined(FVM_TRACE)
 #define FVM_TRACE 1
+#endif
+#if defined(ARDUINO_ARCH_AVR) && (FVM_TRACE == 3)
+#undef FVM_TRACE
+#define FVM_TRACE 1
+#endif
+
+/**
+ * Enable profiler (not AVR); sampled token dispatch counts and ticks
+ * per token (cycles on x86-64 otherwise micro-seconds) with a log2
+ * histogram. Dispatch is recorded in windows between a period of
+ * branches, loops and calls; the counts are estimates scaled from
+ * the windows. Or call graph; number of calls and ticks per word
+ * call path. Pre-decoded code is disabled so that all tokens are
+ * dispatched by the inner interpreter. Read with FVM::profile(),
+ * FVM::graph() or the profile word.
+ * 0: No profiler.
+ * 1: Sampled token counts and ticks.
+ * 2: Call graph with exclusive and inclusive ticks.
+ */
+#if defined(ARDUINO_ARCH_AVR) || !defined(FVM_PROFILER)
+#undef FVM_PROFILER
+#define FVM_PROFILER 0
+#endif
 
 /**
  * Enable kernel dictionary. Remove to reduce foot-print for
@@ -54,13 +100,642 @@
  */
 #define FVM_KERNEL_OPT 1
 
+/**
+ * Select inner interpreter dispatch. Direct threading requires
+ * labels as values (GCC) and a table of operation code addresses in
+ * data memory. It is only used when symbolic trace is disabled.
+ * Select switch dispatch on other targets with -DFVM_DISPATCH=0.
+ * 0: Switch statement; single shared dispatch.
+ * 1: Direct threading; replicated dispatch per operation.
+ */
+#if !defined(FVM_DISPATCH)
+#if defined(ARDUINO_ARCH_AVR)
+#define FVM_DISPATCH 0
+#else
+#define FVM_DISPATCH 1
+#endif
+#endif
+
+/**
+ * Enable pre-decoded code cache for dynamic dictionary words.
+ * Requires direct threading. Words are translated on first call to
+ * handler addresses and decoded operands in the end of the data
+ * area. The byte token code remains the dictionary definition.
+ * Pre-decoded code is only run by the inner interpreter without
+ * trace (not AVR); traced tasks run the threaded code. When trace is
+ * enabled while pre-decoded words are active on the return stack the
+ * task continues without trace until they have returned.
+ * 0: Threaded code only.
+ * 1: Translate and execute pre-decoded code.
+ */
+#if (FVM_DISPATCH == 1) && (FVM_PROFILER == 0)			\
+  && !defined(ARDUINO_ARCH_AVR)
+#define FVM_CACHE 1
+#else
+#define FVM_CACHE 0
+#endif
+
+/**
+ * Enable native code (x86-64) for dynamic dictionary words. Requires
+ * the pre-decoded code cache and 32-bit cells. Translated words are
+ * compiled to machine code in a buffer that is writable only while
+ * code is generated and otherwise executable. Calls and kernel
+ * operations return to the inner interpreter, which continues in
+ * native code after the operation. Words that cannot be compiled are
+ * executed as pre-decoded code.
+ * 0: Pre-decoded code only.
+ * 1: Native code.
+ */
+#if (FVM_CACHE == 1) && (FVM_FUEL == 0) && (FVM_CELL == 32)		\
+  && defined(__x86_64__) && defined(__linux__)
+#define FVM_JIT 1
+#else
+#define FVM_JIT 0
+#endif
+
+/**
+ * Enable loop registers. The index and limit of the innermost loop
+ * are held in locals of the inner interpreter instead of loaded from
+ * and stored to the return stack per iteration. On x86-64 hosts the
+ * frame access is cheap and the extra cache test is not a gain (see
+ * Benchmark). Not measured on AVR; select with -DFVM_LOOP_REG=1.
+ * 0: Loop frame on return stack.
+ * 1: Innermost loop frame in locals.
+ */
+#if !defined(FVM_LOOP_REG)
+#define FVM_LOOP_REG 0
+#endif
+
+/**
+ * Parameter stack cache; number of top elements held in local
+ * variables (registers) by the inner interpreter. The cached elements
+ * are spilled to the stack in memory for yield/halt, extension
+ * function calls and indexed stack access (pick, depth, roll, etc).
+ * Select with -DFVM_STACK_CACHE=2.
+ * 1: Top of stack (tos).
+ * 2: Top and next of stack (tos, nos).
+ */
+#if !defined(FVM_STACK_CACHE)
+#define FVM_STACK_CACHE 1
+#endif
+
+/**
+ * Kernel build profile. Many kernel operations are defined both in
+ * C++ and threaded code. The profile selects the default for these
+ * operations; C++ for speed, threaded code for foot-print. The
+ * balanced profile uses a per operation default.
+ * 0: Size; threaded code.
+ * 1: Balanced; per operation default.
+ * 2: Speed; C++ code.
+ */
+#define FVM_PROFILE_SIZE 0
+#define FVM_PROFILE_BALANCED 1
+#define FVM_PROFILE_SPEED 2
+#if !defined(FVM_PROFILE)
+#define FVM_PROFILE FVM_PROFILE_BALANCED
+#endif
+
+/**
+ * Kernel operation code selection; C++ (1) or threaded code (0).
+ * The argument is the balanced profile default. Override per
+ * operation by defining FVM_CPP_name, e.g. -DFVM_CPP_DOT=1 for C++
+ * print of numbers with the size profile.
+ */
+#if (FVM_PROFILE == FVM_PROFILE_SIZE)
+#define FVM_CPP(balanced) 0
+#elif (FVM_PROFILE == FVM_PROFILE_SPEED)
+#define FVM_CPP(balanced) 1
+#else
+#define FVM_CPP(balanced) balanced
+#endif
+
+#if !defined(FVM_CPP_PLUS_STORE)
+#define FVM_CPP_PLUS_STORE FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_HERE)
+#define FVM_CPP_HERE FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_ALLOT)
+#define FVM_CPP_ALLOT FVM_CPP(0)
+#endif
+// The data-space pointer is a native pointer; here and allot cannot
+// be threaded with dp when cells hold offsets (FVM_OFFSET)
+#if (FVM_OFFSET == 1)
+#undef FVM_CPP_HERE
+#define FVM_CPP_HERE 1
+#undef FVM_CPP_ALLOT
+#define FVM_CPP_ALLOT 1
+#endif
+#if !defined(FVM_CPP_COMMA)
+#define FVM_CPP_COMMA FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_C_COMMA)
+#define FVM_CPP_C_COMMA FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_NIP)
+#define FVM_CPP_NIP FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_DUP)
+#define FVM_CPP_DUP FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_QUESTION_DUP)
+#define FVM_CPP_QUESTION_DUP FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_OVER)
+#define FVM_CPP_OVER FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_TUCK)
+#define FVM_CPP_TUCK FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_SWAP)
+#define FVM_CPP_SWAP FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_ROT)
+#define FVM_CPP_ROT FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_MINUS_ROT)
+#define FVM_CPP_MINUS_ROT FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_CELLS)
+#define FVM_CPP_CELLS FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_NEGATE)
+#define FVM_CPP_NEGATE FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_WITHIN)
+#define FVM_CPP_WITHIN FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_ABS)
+#define FVM_CPP_ABS FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_MIN)
+#define FVM_CPP_MIN FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_MAX)
+#define FVM_CPP_MAX FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_ZERO_NOT_EQUALS)
+#define FVM_CPP_ZERO_NOT_EQUALS FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_ZERO_LESS)
+#define FVM_CPP_ZERO_LESS FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_NOT_EQUALS)
+#define FVM_CPP_NOT_EQUALS FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_LESS)
+#define FVM_CPP_LESS FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_EQUALS)
+#define FVM_CPP_EQUALS FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_GREATER)
+#define FVM_CPP_GREATER FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_WORDS)
+#define FVM_CPP_WORDS FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_HEX)
+#define FVM_CPP_HEX FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_DECIMAL)
+#define FVM_CPP_DECIMAL FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_CR)
+#define FVM_CPP_CR FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_SPACE)
+#define FVM_CPP_SPACE FVM_CPP(1)
+#endif
+#if !defined(FVM_CPP_SPACES)
+#define FVM_CPP_SPACES FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_DOT)
+#define FVM_CPP_DOT FVM_CPP(0)
+#endif
+#if !defined(FVM_CPP_DOT_S)
+#define FVM_CPP_DOT_S FVM_CPP(0)
+#endif
+
 // Forth Virtual Machine support macros
+#if (FVM_DISPATCH == 0)
 #define OP(n) case OP_ ## n:
 #define NEXT() goto INNER
+#else
+#define OP(n) case OP_ ## n: L_ ## n:
+#define NEXT()								\
+  do {									\
+    if (TRACE) goto INNER;						\
+    while ((ir = fetch_byte(ip++)) < 0) {				\
+      PROFILE(KERNEL_MAX + MAP(ir));					\
+      GRAPH_NEST(KERNEL_MAX + MAP(ir));					\
+      NEST();								\
+      ip = FNTAB(MAP(ir));						\
+      FUEL(true);							\
+    }									\
+    goto *OPTAB[(uint8_t) ir];						\
+  } while (0)
+#define L(n) [OP_ ## n] = &&L_ ## n
+#endif
+
+#if (FVM_CACHE == 1)
+#define XOP(n) X_ ## n:
+#define XNEXT() goto *(xp++)->op
+#define X(n) [XC_ ## n] = &&X_ ## n
+
+// Pre-decoded code handlers; index in handler address table
+enum {
+  XC_EXIT,
+  XC_ZERO_EXIT,
+  XC_LIT,
+  XC_PARAM,
+  XC_BRANCH,
+  XC_ZERO_BRANCH,
+  XC_DO,
+  XC_I,
+  XC_J,
+  XC_LEAVE,
+  XC_LOOP,
+  XC_PLUS_LOOP,
+  XC_FOR,
+  XC_NEXT,
+  XC_CALL,
+  XC_BCALL,
+  XC_KERNEL,
+  XC_TO_R,
+  XC_R_FROM,
+  XC_DROP,
+  XC_NIP,
+  XC_DUP,
+  XC_OVER,
+  XC_SWAP,
+  XC_ROT,
+  XC_C_FETCH,
+  XC_C_STORE,
+  XC_FETCH,
+  XC_STORE,
+  XC_INVERT,
+  XC_AND,
+  XC_OR,
+  XC_XOR,
+  XC_NEGATE,
+  XC_ONE_PLUS,
+  XC_ONE_MINUS,
+  XC_TWO_STAR,
+  XC_TWO_SLASH,
+  XC_PLUS,
+  XC_MINUS,
+  XC_STAR,
+  XC_ZERO_LESS,
+  XC_ZERO_EQUALS,
+  XC_NOT_EQUALS,
+  XC_LESS,
+  XC_EQUALS,
+  XC_GREATER,
+  XC_U_LESS,
+  XC_DUP_ZERO_BRANCH,
+  XC_OVER_PLUS,
+  XC_OVER_MINUS,
+  XC_R_FETCH_PLUS,
+  XC_R_FETCH_MINUS,
+  XC_I_FETCH,
+  XC_LIT_PLUS,
+  XC_LIT_EQUALS,
+  XC_NATIVE,
+  XC_MAX
+};
+
+// Pre-decoded code marker; word may not be translated
+#define XCODE_NONE ((FVM::xcode_t*) 1)
+
+#if (FVM_JIT == 1)
+// Native code register save area and enter function; entry address
+// in word code. Returns pre-decoded code to continue with
+struct jit_regs_t {
+  FVM::cell_t* sp;
+  const FVM::code_t** rp;
+  FVM::cell_t tos;
+};
+typedef FVM::xcode_t* (*jit_enter_t)(jit_regs_t* regs, const void* entry);
+#endif
+#endif
+// Profiler; sample windows of token dispatch and ticks (clock) per
+// token. Backward branches, loops and calls (fuel points) count down
+// a period of PROFILE_PERIOD points on average, varied so that the
+// windows do not follow the period of a loop. When the period ends
+// the next dispatches, PROFILE_WINDOW on average, are recorded. With
+// direct threading the dispatch table is switched to the recording
+// handler for the window so that other dispatches have no profiler
+// cost. The window counts are scaled with the fuel points of the
+// period per fuel point in the window. The last token of the window
+// is timed until the next dispatch
+#if (FVM_PROFILER == 1)
+#if defined(__x86_64__)
+#define profile_clock() __rdtsc()
+#else
+#define profile_clock() micros()
+#endif
+#define PROFILE_PERIOD 4096
+#define PROFILE_WINDOW 64
+#if (FVM_DISPATCH == 1)
+#define PROFILE_ACTIVE() (dispatch != optab)
+#define PROFILE_TABLE() dispatch = (s_window ? wtab : optab)
+#define OPTAB dispatch
+#else
+#define PROFILE_ACTIVE() s_window
+#define PROFILE_TABLE() (void) 0
+#endif
+#define PROFILE(token)							\
+  do {									\
+    if (PROFILE_ACTIVE()) {						\
+      countdown = profile_token(token, countdown);			\
+      PROFILE_TABLE();							\
+    }									\
+  } while (0)
+#define PROFILE_POINT()							\
+  (--countdown != 0							\
+   || (countdown = profile_period(), PROFILE_TABLE(), true))
+#define PROFILE_LEAVE() s_countdown = countdown
+
+static FVM::profile_t s_profile;
+static uint32_t s_countdown = PROFILE_PERIOD;
+static uint32_t s_period = PROFILE_PERIOD;
+static uint32_t s_random = 1;
+static bool s_window = false;
+static int s_length;
+static int s_tokens = 0;
+static uint16_t s_token[PROFILE_WINDOW * 3 / 2];
+static int s_sampled = -1;
+static uint64_t s_start;
+
+static void profile_stop()
+{
+  s_window = false;
+  s_sampled = -1;
+}
+
+static uint32_t profile_period() __attribute__((noinline));
+static uint32_t profile_period()
+{
+  s_random ^= s_random << 13;
+  s_random ^= s_random >> 17;
+  s_random ^= s_random << 5;
+  s_period = PROFILE_PERIOD / 2 + (s_random % PROFILE_PERIOD);
+  s_length = PROFILE_WINDOW / 2 + (s_random >> 16) % PROFILE_WINDOW;
+  s_window = true;
+  s_tokens = 0;
+  return (s_period);
+}
+
+static uint32_t profile_token(int token, uint32_t countdown)
+  __attribute__((noinline));
+static uint32_t profile_token(int token, uint32_t countdown)
+{
+  if (!s_window) return (countdown);
+  uint64_t now = profile_clock();
+  if (s_sampled >= 0) {
+    uint64_t ticks = now - s_start;
+    int log2 = 0;
+    while ((ticks >> (log2 + 1)) && (log2 < 31)) log2++;
+    s_profile.samples[s_sampled] += 1;
+    s_profile.ticks[s_sampled] += ticks;
+    s_profile.histogram[log2] += 1;
+    profile_stop();
+    return (countdown);
+  }
+  s_token[s_tokens++] = token;
+  if (s_tokens == s_length) {
+    uint32_t points = s_period - countdown;
+    if (points == 0) points = 1;
+    uint32_t scale = (s_period + points / 2) / points;
+    for (int i = 0; i < s_length; i++)
+      s_profile.count[s_token[i]] += scale;
+    s_sampled = token;
+    s_start = profile_clock();
+  }
+  return (countdown);
+}
+#else
+#define PROFILE(token) (void) 0
+#define PROFILE_POINT() true
+#define OPTAB optab
+#endif
+
+// Call graph profiler; nest and unnest of words moves the task
+// between call graph nodes. Ticks are charged to the current node
+// on each move and when the task is resumed and suspended. A tail
+// call (no return address) replaces the calling node as the callee
+// returns to the caller of the calling node
+#if (FVM_PROFILER == 2)
+#if defined(__x86_64__)
+#define profile_clock() __rdtsc()
+#else
+#define profile_clock() micros()
+#endif
+#if (FVM_KERNEL_OPT == 1)
+#define GRAPH_NEST(token) graph_nest(task, token, fetch_byte(ip) == 0)
+#else
+#define GRAPH_NEST(token) graph_nest(task, token, false)
+#endif
+#define GRAPH_UNNEST() graph_unnest(task)
+#define PROFILE_LEAVE() graph_leave(task, outer)
+
+static FVM::graph_t s_graph = { 1 };
+static FVM::task_t* s_task = 0;
+static uint64_t s_last;
+
+static void graph_charge(int node)
+{
+  uint64_t now = profile_clock();
+  if (node >= 0) s_graph.node[node].ticks += now - s_last;
+  s_last = now;
+}
+
+static FVM::task_t* graph_enter(FVM::task_t& task)
+{
+  FVM::task_t* outer = s_task;
+  graph_charge(outer != 0 ? outer->m_node : -1);
+  s_task = &task;
+  return (outer);
+}
+
+static void graph_leave(FVM::task_t& task, FVM::task_t* outer)
+{
+  graph_charge(task.m_node);
+  s_task = outer;
+}
+
+static void graph_unnest(FVM::task_t& task)
+{
+  graph_charge(task.m_node);
+  if (task.m_lost != 0)
+    task.m_lost -= 1;
+  else
+    task.m_node = s_graph.node[task.m_node].parent;
+}
+
+static void graph_nest(FVM::task_t& task, int token, bool tail)
+{
+  if (tail)
+    graph_unnest(task);
+  else
+    graph_charge(task.m_node);
+  if (task.m_lost != 0) {
+    task.m_lost += 1;
+    return;
+  }
+  FVM::graph_t::node_t* np = &s_graph.node[task.m_node];
+  int nr = np->child;
+  while (nr != 0 && s_graph.node[nr].token != token)
+    nr = s_graph.node[nr].sibling;
+  if (nr == 0) {
+    if (s_graph.nodes == FVM::GRAPH_MAX) {
+      task.m_lost = 1;
+      return;
+    }
+    nr = s_graph.nodes++;
+    s_graph.node[nr].token = token;
+    s_graph.node[nr].parent = task.m_node;
+    s_graph.node[nr].sibling = np->child;
+    np->child = nr;
+  }
+  s_graph.node[nr].calls += 1;
+  task.m_node = nr;
+}
+
+static void graph_halt(FVM::task_t& task)
+{
+  graph_charge(task.m_node);
+  task.m_node = 0;
+  task.m_lost = 0;
+}
+#else
+#define GRAPH_NEST(token) (void) 0
+#define GRAPH_UNNEST() (void) 0
+#endif
+#if (FVM_PROFILER == 0)
+#define PROFILE_LEAVE() (void) 0
+#endif
+
+// Binary trace ring buffer and number of written records
+#if (FVM_TRACE == 3)
+static FVM::trace_t s_trace[FVM::TRACE_MAX];
+static uint32_t s_trace_count = 0;
+#endif
+
 #define FALLTHROUGH()
 #define CALL(fn) tp = fn; goto FNCALL
+#define COLD() goto COLDCALL
 #define MAP(if) (-ir-1)
 
+// Parameter stack access; push and pop top of stack, pop next of
+// stack, next and third element, and spill/fill to/from memory
+#if (FVM_STACK_CACHE == 1)
+#  define PUSH() *++sp = tos
+#  define POP() tos = *sp--
+#  define POP_NOS() sp -= 1
+#  define NOS (*sp)
+#  define THIRD (*(sp - 1))
+#  define SPILL_NOS() (void) 0
+#  define FILL_NOS() (void) 0
+#else
+#  define PUSH() (*++sp = nos, nos = tos)
+#  define POP() (tos = nos, nos = *sp--)
+#  define POP_NOS() nos = *sp--
+#  define NOS nos
+#  define THIRD (*sp)
+#  define SPILL_NOS() *++sp = nos
+#  define FILL_NOS() nos = *sp--
+#endif
+#define SPILL() (SPILL_NOS(), *++sp = tos)
+#define FILL() (tos = *sp--, FILL_NOS())
+
+#if (FVM_KERNEL_OPT == 1)
+#  define NEST() if (fetch_byte(ip)) *++rp = ip
+#else
+#  define NEST() *++rp = ip
+#endif
+
+// Return stack element to and from cell. Elements are pointers; the
+// conversion is through intptr_t as cells may be narrower (32-bit
+// cells on 64-bit hosts). The element holds the value, not a cell
+// address (pointer()), as native code uses the frame directly
+#define RCELL(x) ((cell_t) (intptr_t) (x))
+#define RCODE(x) ((code_P) (intptr_t) (x))
+
+// Loop frame access; the frame, limit and index, is on the return
+// stack. With loop registers the index and limit of the innermost
+// loop are kept in locals (li, ll) while the frame is at lp. The
+// index is written back (spilled) when a loop is nested, the frame is
+// popped (r>) and on return from inner. Calls and >r push above the
+// frame and need no spill. Loop operations load the frame from the
+// return stack when it is not cached. Without loop registers the
+// frame is loaded and the index stored per iteration
+#if (FVM_LOOP_REG == 1)
+#define LOOP_SPILL()							\
+  if (lp != 0) {							\
+    *lp = RCODE(li);							\
+    lp = 0;								\
+  }
+#define LOOP_FILL()							\
+  if (lp != rp) {							\
+    LOOP_SPILL();							\
+    li = RCELL(*rp);							\
+    ll = RCELL(*(rp - 1));						\
+    lp = rp;								\
+  }
+#define LOOP_STORE()
+#define LOOP_ENTER(index,limit)						\
+  LOOP_SPILL();								\
+  *++rp = RCODE(limit);							\
+  lp = ++rp;								\
+  li = (index);								\
+  ll = (limit)
+#define LOOP_INDEX() ((lp == rp) ? li : RCELL(*rp))
+#define LOOP_POP() if (lp == rp) LOOP_SPILL()
+#define LOOP_RESET() lp = 0
+#define LOOP_EXIT() (rp -= 2, lp = 0)
+#else
+#define LOOP_SPILL()
+#define LOOP_FILL()							\
+  li = RCELL(*rp);							\
+  ll = RCELL(*(rp - 1))
+#define LOOP_STORE() *rp = RCODE(li)
+#define LOOP_ENTER(index,limit)						\
+  *++rp = RCODE(limit);							\
+  *++rp = RCODE(index)
+#define LOOP_INDEX() RCELL(*rp)
+#define LOOP_POP()
+#define LOOP_RESET()
+#define LOOP_EXIT() (rp -= 2)
+#endif
+
+// Instruction budget; decrement on condition (backward branch, loop
+// or call) and preempt when used. Pre-decoded code continues on
+// resume through CACHE_CODE
+#if (FVM_FUEL == 1)
+#  define FUEL(cond)							\
+  if ((cond) && PROFILE_POINT() && --fuel == 0 && budget != 0)		\
+    goto PREEMPT
+#  define XFUEL(cond)							\
+  if ((cond) && --fuel == 0 && budget != 0) {				\
+    *++rp = (code_P) xp;						\
+    ip = CACHE_CODE + 1;						\
+    goto PREEMPT;							\
+  }
+#elif (FVM_PROFILER == 1)
+#  define FUEL(cond) if (cond) (void) PROFILE_POINT()
+#  define XFUEL(cond) (void) 0
+#else
+#  define FUEL(cond) (void) 0
+#  define XFUEL(cond) (void) 0
+#endif
+
+// Buffered output; drain when more than half full (DRAIN) or at end
+// of line (FLUSH), and yield when the stream does not accept the data
+#define DRAIN() if (task.m_out.busy()) goto OUTPUT_BLOCKED
+#define FLUSH() if (!task.m_out.drain()) goto OUTPUT_BLOCKED
+
 #if defined(ARDUINO_ARCH_AVR)
 #  define FNTAB(ix) (code_P) pgm_read_word(fntab+ix)
 #  define FNSTR(ix) (const __FlashStringHelper*) pgm_read_word(fnstr+ix)
@@ -101,113 +776,702 @@ FVM::cell_t fetch_word(FVM::code_P ip)
 
 #endif
 
-int FVM::lookup(const char* name)
+// Origin of cell addresses; a cell holds the offset from the origin
+// when pointers do not fit in a cell (FVM_OFFSET)
+uint8_t FVM::s_origin[sizeof(FVM::cell_t)];
+
+// Fetch long branch offset (16-bit, little-endian)
+#define fetch_offset(ip)						\
+  ((uint8_t) fetch_byte(ip) | (fetch_byte((ip) + 1) << 8))
+
+#if !defined(ARDUINO_ARCH_AVR)
+// Dictionary hash index; FNV-1a hash of name. The sketch and kernel
+// dictionary index is built on first lookup with token plus one;
+// sketch words before kernel words and only the first of equal names
+// so that the search order is kept
+#define LOOKUP_MAX 1024
+
+static uint16_t s_lookup[LOOKUP_MAX];
+static bool s_lookup_init = false;
+
+static uint32_t lookup_hash(const char* name, size_t len)
+{
+  uint32_t hash = 2166136261UL;
+  while (len--) hash = (hash ^ (uint8_t) *name++) * 16777619UL;
+  return (hash);
+}
+
+// Compare string with given length and null terminated string
+static bool lookup_equals(const char* name, size_t len, const char* s)
+{
+  return (!strncmp(name, s, len) && s[len] == 0);
+}
+
+void FVM::index_name(uint8_t nr)
+{
+  const char* name = m_name[nr];
+  uint32_t i = lookup_hash(name, strlen(name));
+  for (; m_index[i & (INDEX_MAX - 1)] != 0; i++)
+    if (!strcmp(name, m_name[m_index[i & (INDEX_MAX - 1)] - 1])) return;
+  m_index[i & (INDEX_MAX - 1)] = nr + 1;
+}
+
+const char* FVM::lookup_name(int token)
+{
+  if (token < FVM::KERNEL_MAX) return ((const char*) OPSTR(token));
+  return ((const char*) FNSTR(token - FVM::KERNEL_MAX));
+}
+
+void FVM::lookup_index(int token)
+{
+  const char* name = lookup_name(token);
+  uint32_t i = lookup_hash(name, strlen(name));
+  for (; s_lookup[i & (LOOKUP_MAX - 1)] != 0; i++)
+    if (!strcmp(name, lookup_name(s_lookup[i & (LOOKUP_MAX - 1)] - 1)))
+      return;
+  s_lookup[i & (LOOKUP_MAX - 1)] = token + 1;
+}
+
+int FVM::lookup(const char* name, size_t len)
+{
+  uint32_t hash = lookup_hash(name, len);
+  uint16_t token;
+
+  // Search dynamic sketch dictionary index, return index
+  for (uint32_t i = hash; m_index[i & (INDEX_MAX - 1)] != 0; i++) {
+    int nr = m_index[i & (INDEX_MAX - 1)] - 1;
+    if (lookup_equals(name, len, m_name[nr]))
+      return (nr + FVM::APPLICATION_MAX);
+  }
+
+  // Build static sketch and kernel dictionary index
+  if (!s_lookup_init) {
+    for (int i = 0; FNSTR(i) != 0; i++) lookup_index(i + FVM::KERNEL_MAX);
+    for (int i = 0; OPSTR(i) != 0; i++) lookup_index(i);
+    s_lookup_init = true;
+  }
+
+  // Search static sketch and kernel dictionary index, return index
+  for (uint32_t i = hash; (token = s_lookup[i & (LOOKUP_MAX - 1)]) != 0; i++)
+    if (lookup_equals(name, len, lookup_name(token - 1))) return (token - 1);
+
+  // Return error code
+  return (-1);
+}
+#else
+// Compare string with given length and null terminated string in
+// program memory
+static bool lookup_equals_P(const char* name, size_t len, const char* s)
+{
+  return (!strncmp_P(name, s, len) && pgm_read_byte(s + len) == 0);
+}
+
+int FVM::lookup(const char* name, size_t len)
 {
   const char* s;
 
   // Search dynamic sketch dictionary, return index
   for (int i = 0; i < m_next; i++)
-    if (!strcmp(name, m_name[i])) return (i + FVM::APPLICATION_MAX);
+    if (!strncmp(name, m_name[i], len) && m_name[i][len] == 0)
+      return (i + FVM::APPLICATION_MAX);
 
   // Search static sketch dictionary, return index
   for (int i = 0; (s = (const char*) FNSTR(i)) != 0; i++)
-    if (!strcmp_P(name, s)) return (i + FVM::KERNEL_MAX);
+    if (lookup_equals_P(name, len, s)) return (i + FVM::KERNEL_MAX);
 
   // Search static kernel dictionary, return index
   for (int i = 0; (s = (const char*) OPSTR(i)) != 0; i++)
-    if (!strcmp_P(name, s)) return (i);
+    if (lookup_equals_P(name, len, s)) return (i);
 
   // Return error code
   return (-1);
 }
+#endif
 
 int FVM::scan(char* bp, task_t& task)
 {
-  Stream& ios = task.m_ios;
-  char c;
-
-  // Skip white space (blocking)
-  do {
-    while (!ios.available());
-    c = ios.read();
-  } while (c <= ' ');
+  int c;
 
   // Scan until white space (blocking)
-  do {
-    *bp++ = c;
-    while (!ios.available());
-    c = ios.read();
-   } while (c > ' ');
-  *bp = 0;
-
+  while ((c = scan_available(bp, task)) < 0);
   return (c);
 }
 
-int FVM::resume(task_t& task)
+int FVM::scan_available(char* bp, task_t& task)
 {
-  // Restore virtual machine state
   Stream& ios = task.m_ios;
-  const code_t** rp = task.m_rp;
-  const code_t* ip = *rp--;
-  cell_t* sp = task.m_sp;
-  cell_t tos = *sp--;
-  const code_t* tp;
-  cell_t tmp;
-  int8_t ir;
 
-  // Benchmark support in trace mode; measure micro-seconds per operation
-#if (FVM_TRACE == 2)
-  uint32_t start = micros();
-#endif
+  // Skip white space and scan until white space. The token length is
+  // kept in the task between calls
+  while (ios.available()) {
+    char c = ios.read();
+    if (c > ' ') {
+      bp[task.m_scan++] = c;
+    }
+    else if (task.m_scan != 0) {
+      bp[task.m_scan] = 0;
+      task.m_scan = 0;
+      return ((uint8_t) c);
+    }
+  }
+  return (-1);
+}
 
- INNER:
-  // Positive opcode (0..127) are direct operation codes. Negative
-  // opcodes (-1..-128) are negative index (plus one) in threaded code
-  // table. Direct operation codes may be implemented as a primitive
-  // or as an internal threaded code call.
-  //
-  // The virtual machine allows 512 tokens. These are used as follows:
-  // Kernel tokens 0..255: 0..127 direct, 128..255 OP_SYSCALL prefix.
-  // Application tokens 256..511: 256..383 direct, -1..-128, indexing
-  // threaded code table in program memory 0..127, 384..511, indexing
-  // threaded code table in data memory 0..127 OP_CALL prefix.
-  //
-  // Kernel inner may be configured for tail call optimization.
-  //
-  // Kernel operations are documented according to ANSI X3.215-1994,
-  // American National Standard for Information Systems, Programming
-  // Languages - Forth, March 24, 1994.
-#if (FVM_TRACE == 0)
+// Check for branch operation code; offset relative the offset byte
+static bool is_branch(uint8_t op)
+{
+  return ((op == FVM::OP_BRANCH)
+	  || (op == FVM::OP_ZERO_BRANCH)
+	  || (op == FVM::OP_DO)
+	  || (op == FVM::OP_LOOP)
+	  || (op == FVM::OP_PLUS_LOOP)
+	  || (op == FVM::OP_FOR)
+	  || (op == FVM::OP_NEXT)
+	  || (op == FVM::OP_DUP_ZERO_BRANCH)
+	  || (op == FVM::OP_SLIT));
+}
 
-  while ((ir = fetch_byte(ip++)) < 0) {
-#if (FVM_KERNEL_OPT == 1)
-    if (fetch_byte(ip)) *++rp = ip;
-#else
-    *++rp = ip;
-#endif
-    ip = FNTAB(MAP(ir));
+// Check for long branch; branch operation code with syscall prefix
+static bool is_long(const uint8_t* dp)
+{
+  return ((dp[0] == FVM::OP_SYSCALL)
+	  && (dp[1] == FVM::OP_BRANCH
+	      || dp[1] == FVM::OP_ZERO_BRANCH
+	      || dp[1] == FVM::OP_DO
+	      || dp[1] == FVM::OP_LOOP
+	      || dp[1] == FVM::OP_PLUS_LOOP
+	      || dp[1] == FVM::OP_FOR
+	      || dp[1] == FVM::OP_NEXT));
+}
+
+// Length of token in data memory; operation code, inline operands and
+// data. Zero for data structures (variable, constant, etc)
+static int token_length(const uint8_t* dp)
+{
+  switch (*dp) {
+  case FVM::OP_LIT:
+    return (3);
+  case FVM::OP_WLIT:
+    return (1 + sizeof(FVM::cell_t));
+  case FVM::OP_SYSCALL:
+    return (is_long(dp) ? 4 : 2);
+  case FVM::OP_CLIT:
+  case FVM::OP_PARAM:
+  case FVM::OP_BRANCH:
+  case FVM::OP_ZERO_BRANCH:
+  case FVM::OP_DO:
+  case FVM::OP_LOOP:
+  case FVM::OP_PLUS_LOOP:
+  case FVM::OP_FOR:
+  case FVM::OP_NEXT:
+  case FVM::OP_CALL:
+  case FVM::OP_COMPILE:
+  case FVM::OP_DUP_ZERO_BRANCH:
+  case FVM::OP_CLIT_PLUS:
+  case FVM::OP_CLIT_EQUALS:
+    return (2);
+  case FVM::OP_SLIT:
+    return (1 + (int8_t) dp[1]);
+  case FVM::OP_DOT_QUOTE:
+    return (strlen((const char*) dp + 1) + 2);
+  case FVM::OP_VAR:
+  case FVM::OP_CONST:
+  case FVM::OP_FUNC:
+  case FVM::OP_DOES:
+    return (0);
   }
+  return (1);
+}
 
-#else
-  // Trace execution; micro-seconds, instruction pointer,
-  // return stack depth, token, and stack contents
-  do {
-    if (task.m_trace) {
-#if (FVM_TRACE == 2)
-      uint32_t stop = micros();
-#endif
-      ios.print(F("task@"));
-      ios.print((ucell_t) &task);
-      ios.print(':');
-#if (FVM_TRACE == 2)
-      // Print measurement of latest operation; micro-seconds
-      ios.print(stop - start);
-      ios.print(':');
-      // Print current instruction pointer
-      ios.print((ucell_t) ip);
-      ios.print(':');
-      // Print current return stack depth
-      ios.print((uint16_t) (rp - task.m_rp0));
+// Branch offset of token in data memory; short (8-bit) or long
+// (16-bit). Return offset field and length, zero if not a branch
+static int branch_field(uint8_t* dp, uint8_t*& fp)
+{
+  if (is_long(dp)) {
+    fp = dp + 2;
+    return (2);
+  }
+  if (is_branch(*dp)) {
+    fp = dp + 1;
+    return (1);
+  }
+  return (0);
+}
+
+static int read_offset(const uint8_t* fp, int len)
+{
+  if (len == 1) return ((int8_t) fp[0]);
+  return ((int16_t) (fp[0] | (fp[1] << 8)));
+}
+
+static void write_offset(uint8_t* fp, int len, int offset)
+{
+  fp[0] = offset;
+  if (len == 2) fp[1] = offset >> 8;
+}
+
+// Check if the given position is a branch target
+static bool is_target(uint8_t* body, uint8_t* end, uint8_t* dp)
+{
+  uint8_t* fp;
+  int len;
+  int n;
+
+  for (uint8_t* tp = body; tp < end && (len = token_length(tp)) != 0; tp += len)
+    if ((n = branch_field(tp, fp)) != 0 && fp + read_offset(fp, n) == dp)
+      return (true);
+  return (false);
+}
+
+// Remove bytes and adjust branch offsets over the removed bytes.
+// Offset fields within the removed bytes are not adjusted
+static void remove_code(uint8_t* body, uint8_t*& end, uint8_t* rp, int count)
+{
+  uint8_t* fp;
+  int len;
+  int n;
+
+  for (uint8_t* tp = body; tp < end && (len = token_length(tp)) != 0; tp += len) {
+    if ((n = branch_field(tp, fp)) == 0) continue;
+    if (fp >= rp && fp < rp + count) continue;
+    int offset = read_offset(fp, n);
+    uint8_t* dest = fp + offset;
+    if (fp < rp && dest >= rp + count) offset -= count;
+    else if (fp >= rp + count && dest < rp) offset += count;
+    write_offset(fp, n, offset);
+  }
+  memmove(rp, rp + count, end - (rp + count));
+  end -= count;
+}
+
+// Peephole rewrite rules; token pair and superinstruction
+static const uint8_t peephole[][3] PROGMEM = {
+  { FVM::OP_SWAP, FVM::OP_DROP, FVM::OP_NIP },
+  { FVM::OP_DUP, FVM::OP_ZERO_BRANCH, FVM::OP_DUP_ZERO_BRANCH },
+  { FVM::OP_OVER, FVM::OP_PLUS, FVM::OP_OVER_PLUS },
+  { FVM::OP_OVER, FVM::OP_MINUS, FVM::OP_OVER_MINUS },
+  { FVM::OP_R_FETCH, FVM::OP_PLUS, FVM::OP_R_FETCH_PLUS },
+  { FVM::OP_R_FETCH, FVM::OP_MINUS, FVM::OP_R_FETCH_MINUS },
+  { FVM::OP_R_FETCH, FVM::OP_FETCH, FVM::OP_I_FETCH },
+  { FVM::OP_I, FVM::OP_FETCH, FVM::OP_I_FETCH },
+  { FVM::OP_ZERO, FVM::OP_NOT_EQUALS, FVM::OP_ZERO_NOT_EQUALS },
+  { FVM::OP_ZERO, FVM::OP_LESS, FVM::OP_ZERO_LESS },
+  { FVM::OP_ZERO, FVM::OP_EQUALS, FVM::OP_ZERO_EQUALS },
+  { FVM::OP_ZERO, FVM::OP_GREATER, FVM::OP_ZERO_GREATER },
+  { FVM::OP_ONE, FVM::OP_PLUS, FVM::OP_ONE_PLUS },
+  { FVM::OP_ONE, FVM::OP_MINUS, FVM::OP_ONE_MINUS },
+  { FVM::OP_TWO, FVM::OP_PLUS, FVM::OP_TWO_PLUS },
+  { FVM::OP_TWO, FVM::OP_MINUS, FVM::OP_TWO_MINUS },
+  { FVM::OP_TWO, FVM::OP_STAR, FVM::OP_TWO_STAR },
+  { 0, 0, 0 }
+};
+
+int FVM::optimize()
+{
+  if (m_next == 0) return (0);
+  const char* name = m_name[m_next - 1];
+  uint8_t* body = (uint8_t*) name + strlen(name) + 1;
+  int res = 0;
+  int n;
+
+  // Repeat until no further rewrites; relaxing a branch may allow
+  // relaxing a previous branch
+  do {
+    uint8_t* dp = body;
+    int len;
+    n = 0;
+    while (dp < m_dp && (len = token_length(dp)) != 0) {
+      // Relax long branch when the offset fits; remove the prefix and
+      // offset high byte
+      if (is_long(dp)) {
+	uint8_t* dest = dp + 2 + read_offset(dp + 2, 2);
+	int offset = dest - (dp + 1);
+	if (dest > dp) offset -= 2;
+	if (offset >= -128 && offset <= 127) {
+	  uint8_t op = dp[1];
+	  remove_code(body, m_dp, dp + 2, 2);
+	  dp[0] = op;
+	  dp[1] = offset;
+	  n += 1;
+	  continue;
+	}
+      }
+
+      uint8_t* np = dp + len;
+      uint8_t op = *dp;
+      uint8_t code = 0;
+      int8_t val = 0;
+      bool operand = false;
+      if (np >= m_dp) break;
+
+      // Small literals are matched as constant operations
+      if (op == OP_CLIT) {
+	val = dp[1];
+	if (val == 0) op = OP_ZERO;
+	else if (val == 1) op = OP_ONE;
+	else if (val == 2) op = OP_TWO;
+      }
+
+      // Match token pair with rules. Otherwise superinstruction with
+      // inline literal
+      for (int i = 0; pgm_read_byte(&peephole[i][0]) != 0; i++) {
+	if (pgm_read_byte(&peephole[i][0]) == op
+	    && pgm_read_byte(&peephole[i][1]) == *np) {
+	  code = pgm_read_byte(&peephole[i][2]);
+	  break;
+	}
+      }
+      if (code == 0 && *dp == OP_CLIT) {
+	operand = true;
+	if (*np == OP_PLUS)
+	  code = OP_CLIT_PLUS;
+	else if (*np == OP_MINUS && val != INT8_MIN) {
+	  code = OP_CLIT_PLUS;
+	  val = -val;
+	}
+	else if (*np == OP_EQUALS)
+	  code = OP_CLIT_EQUALS;
+      }
+
+      // Check that the second token is not a branch target
+      if (code == 0 || is_target(body, m_dp, np)) {
+	dp = np;
+	continue;
+      }
+
+      // Remove operation code of second token and first token operand
+      // (when not used). Rewrite first token and check rules again
+      uint8_t* rp = dp + (operand ? 2 : 1);
+      remove_code(body, m_dp, rp, (np + 1) - rp);
+      *dp = code;
+      if (operand) dp[1] = val;
+      n += 1;
+    }
+    res += n;
+  } while (n != 0);
+  return (res);
+}
+
+// Trace support; full token (with prefix) at instruction pointer
+// and trace filter. The filter token is traced from the call until
+// return (below the call depth). A call followed by exit (tail call)
+// does not increment the return stack depth
+#if (FVM_TRACE != 0)
+static int trace_token(FVM::code_P ip)
+{
+  int8_t ir = fetch_byte(ip);
+  if (ir < 0) return (FVM::KERNEL_MAX - ir - 1);
+  if (ir == FVM::OP_CALL)
+    return (FVM::APPLICATION_MAX + (uint8_t) fetch_byte(ip + 1));
+  if (ir == FVM::OP_SYSCALL) return ((uint8_t) fetch_byte(ip + 1));
+  return (ir);
+}
+
+static inline bool trace_filter(FVM::task_t& task, FVM::code_P ip, int depth)
+{
+  if (task.m_filter != 0) {
+    if (task.m_extent != 0 && depth + 1 < task.m_extent)
+      task.m_extent = 0;
+    if (task.m_extent == 0) {
+      if (trace_token(ip) != task.m_filter) return (false);
+      int8_t ir = fetch_byte(ip);
+      int length = (ir == FVM::OP_CALL || ir == FVM::OP_SYSCALL) ? 2 : 1;
+      bool tail = (FVM_KERNEL_OPT == 1) && (fetch_byte(ip + length) == 0);
+      task.m_extent = depth + (tail ? 1 : 2);
+    }
+  }
+  if (depth < task.m_depth_min || depth > task.m_depth_max) return (false);
+  if (task.m_period > 1) {
+    if (++task.m_count < task.m_period) return (false);
+    task.m_count = 0;
+  }
+  return (true);
+}
+#endif
+
+// Return value from inner interpreter when trace mode is changed;
+// resume with the other inner interpreter
+#define TRACE_SWITCH 3
+
+#if (FVM_CACHE == 1) && (FVM_TRACE != 0)
+// Return to threaded code marker of the inner interpreter without
+// trace (XRET); set on entry
+static const FVM::xcode_t* s_xret = 0;
+
+// Check for pre-decoded code on the return stack; the traced inner
+// interpreter cannot continue pre-decoded code
+static bool xactive(const FVM::code_t** rp0, const FVM::code_t** rp)
+{
+  while (rp > rp0)
+    if (*rp-- == (FVM::code_P) s_xret) return (true);
+  return (false);
+}
+#define TRACED(task,rp) ((task).m_trace && !xactive((task).m_rp0, rp))
+#else
+#define TRACED(task,rp) ((task).m_trace)
+#endif
+
+int FVM::resume(task_t& task, uint32_t budget)
+{
+  int res;
+#if (FVM_FUEL == 0)
+  // Budget without fuel; the task would never be preempted
+  if (budget != 0) return (-1);
+#endif
+#if (FVM_TRACE == 0)
+  res = inner<false>(task, budget);
+#elif defined(ARDUINO_ARCH_AVR)
+  res = inner<true>(task, budget);
+#else
+  do {
+    res = TRACED(task, task.m_rp) ?
+      inner<true>(task, budget) :
+      inner<false>(task, budget);
+  } while (res == TRACE_SWITCH);
+#endif
+
+  // Drain buffered output on yield; flush on halt or error
+  if (res > 0)
+    task.m_out.drain();
+  else
+    task.m_out.flush();
+  return (res);
+}
+
+template<bool TRACE>
+int FVM::inner(task_t& task, uint32_t budget)
+{
+  // Restore virtual machine state; output is buffered when not traced
+  Stream& ios = task.m_ios;
+  Print& out = (task.m_trace || !task.m_out.buffered()) ?
+    (Print&) ios :
+    (Print&) task.m_out;
+  const code_t** rp = task.m_rp;
+  const code_t* ip = *rp--;
+  cell_t* sp = task.m_sp;
+#if (FVM_STACK_CACHE == 2)
+  cell_t nos;
+#endif
+  cell_t tos;
+  const code_t* tp;
+  cell_t tmp;
+  int8_t ir;
+  FILL();
+
+  // Innermost loop index and limit; frame on return stack or null
+#if (FVM_LOOP_REG == 1)
+  const code_t** lp = 0;
+  cell_t li = 0;
+  cell_t ll = 0;
+#else
+  cell_t li;
+  cell_t ll;
+#endif
+
+  // Instruction budget; zero for none
+#if (FVM_FUEL == 1)
+  uint32_t fuel = budget;
+#else
+  (void) budget;
+#endif
+
+  // Profiler; restart sampling or charge calling task
+#if (FVM_PROFILER == 1)
+  if (s_sampled >= 0) profile_stop();
+  uint32_t countdown = s_countdown;
+#elif (FVM_PROFILER == 2)
+  task_t* outer = graph_enter(task);
+#endif
+
+  // Direct threading; operation code address table
+#if (FVM_DISPATCH == 1)
+  static const void* const optab[] = {
+    L(EXIT), L(ZERO_EXIT), L(LIT), L(CLIT),
+    L(SLIT), L(VAR), L(CONST), L(FUNC),
+    L(DOES), L(PARAM), L(BRANCH), L(ZERO_BRANCH),
+    L(DO), L(I), L(J), L(LEAVE),
+    L(LOOP), L(PLUS_LOOP), L(NOOP), L(EXECUTE),
+    L(HALT), L(YIELD), L(SYSCALL), L(CALL),
+    L(TRACE), L(FOR), L(C_FETCH), L(C_STORE),
+    L(FETCH), L(STORE), L(PLUS_STORE), L(DP),
+    L(HERE), L(ALLOT), L(COMMA), L(C_COMMA),
+    L(COMPILE), L(TO_R), L(R_FROM), L(R_FETCH),
+    L(SP), L(DEPTH), L(DROP), L(NIP),
+    L(EMPTY), L(DUP), L(QUESTION_DUP), L(OVER),
+    L(TUCK), L(PICK), L(SWAP), L(ROT),
+    L(MINUS_ROT), L(ROLL), L(TWO_SWAP), L(TWO_DUP),
+    L(TWO_OVER), L(TWO_DROP), L(MINUS_TWO), L(MINUS_ONE),
+    L(ZERO), L(ONE), L(TWO), L(CELL),
+    L(CELLS), L(BOOL), L(NOT), L(TRUE),
+    L(FALSE), L(INVERT), L(AND), L(OR),
+    L(XOR), L(NEGATE), L(ONE_PLUS), L(ONE_MINUS),
+    L(TWO_PLUS), L(TWO_MINUS), L(TWO_STAR), L(TWO_SLASH),
+    L(PLUS), L(MINUS), L(STAR), L(STAR_SLASH),
+    L(SLASH), L(MOD), L(SLASH_MOD), L(LSHIFT),
+    L(RSHIFT), L(WITHIN), L(ABS), L(MIN),
+    L(MAX), L(ZERO_NOT_EQUALS), L(ZERO_LESS), L(ZERO_EQUALS),
+    L(ZERO_GREATER), L(NOT_EQUALS), L(LESS), L(EQUALS),
+    L(GREATER), L(U_LESS), L(DUP_ZERO_BRANCH), L(OVER_PLUS),
+    L(OVER_MINUS), L(R_FETCH_PLUS), L(R_FETCH_MINUS), L(I_FETCH),
+    L(CLIT_PLUS), L(CLIT_EQUALS), L(EMIT), L(CR),
+    L(SPACE), L(SPACES), L(U_DOT), L(DOT),
+    L(DOT_S), L(DOT_QUOTE), L(NEXT), L(DOT_NAME),
+    L(WLIT), L(MICROS), L(MILLIS), L(DELAY),
+    L(PINMODE), L(DIGITALREAD), L(DIGITALWRITE), L(DIGITALTOGGLE),
+    L(ANALOGREAD), L(ANALOGWRITE), L(LOOKUP), L(TO_BODY),
+    L(WORDS), L(BASE), L(HEX), L(DECIMAL),
+    L(QUESTION_KEY), L(KEY),
+#if (FVM_CACHE == 1)
+    L(CACHE),
+#else
+    [OP_CACHE] = 0,
+#endif
+    L(PROFILE), L(TRACE_FILTER), L(QUESTION), L(TYPE),
+    L(ROOM)
+  };
+
+  // Profiler; dispatch table for the sample window
+#if (FVM_PROFILER == 1)
+  static const void* wtab[CORE_MAX];
+  if (wtab[0] == 0)
+    for (int i = 0; i < CORE_MAX; i++) wtab[i] = &&PROFILE_RECORD;
+  const void* const* dispatch = s_window ? wtab : optab;
+#endif
+#endif
+
+  // Pre-decoded code; handler address table, return to threaded
+  // code, and threaded code return to pre-decoded code
+#if (FVM_CACHE == 1)
+  static const void* const xtab[] = {
+    X(EXIT), X(ZERO_EXIT), X(LIT), X(PARAM),
+    X(BRANCH), X(ZERO_BRANCH), X(DO), X(I),
+    X(J), X(LEAVE), X(LOOP), X(PLUS_LOOP),
+    X(FOR), X(NEXT), X(CALL), X(BCALL),
+    X(KERNEL), X(TO_R), X(R_FROM), X(DROP),
+    X(NIP), X(DUP), X(OVER), X(SWAP),
+    X(ROT), X(C_FETCH), X(C_STORE), X(FETCH),
+    X(STORE), X(INVERT), X(AND), X(OR),
+    X(XOR), X(NEGATE), X(ONE_PLUS), X(ONE_MINUS),
+    X(TWO_STAR), X(TWO_SLASH), X(PLUS), X(MINUS),
+    X(STAR), X(ZERO_LESS), X(ZERO_EQUALS), X(NOT_EQUALS),
+    X(LESS), X(EQUALS), X(GREATER), X(U_LESS),
+    X(DUP_ZERO_BRANCH), X(OVER_PLUS), X(OVER_MINUS), X(R_FETCH_PLUS),
+    X(R_FETCH_MINUS), X(I_FETCH), X(LIT_PLUS), X(LIT_EQUALS),
+#if (FVM_JIT == 1)
+    X(NATIVE)
+#endif
+  };
+  static const xcode_t XRET[] = {
+    { &&X_RET }
+  };
+  static const code_t CACHE_CODE[] PROGMEM = {
+    FVM_OP(HALT),
+    FVM_OP(SYSCALL),
+    code_t(OP_CACHE)
+  };
+  xcode_t* xp = 0;
+#if (FVM_TRACE != 0)
+  if (!TRACE) s_xret = XRET;
+#endif
+#endif
+
+  // Benchmark support in trace mode; measure micro-seconds per operation
+#if (FVM_TRACE == 2)
+  uint32_t start = micros();
+#endif
+
+#if (FVM_DISPATCH == 1)
+  NEXT();
+#if (FVM_PROFILER == 1)
+  // Record dispatch in profiler sample window
+ PROFILE_RECORD:
+  countdown = profile_token((uint8_t) ir, countdown);
+  PROFILE_TABLE();
+  goto *optab[(uint8_t) ir];
+#endif
+#endif
+ INNER:
+  // Positive opcode (0..127) are direct operation codes. Negative
+  // opcodes (-1..-128) are negative index (plus one) in threaded code
+  // table. Direct operation codes may be implemented as a primitive
+  // or as an internal threaded code call.
+  //
+  // The virtual machine allows 512 tokens. These are used as follows:
+  // Kernel tokens 0..255: 0..127 direct, 128..255 OP_SYSCALL prefix.
+  // Application tokens 256..511: 256..383 direct, -1..-128, indexing
+  // threaded code table in program memory 0..127, 384..511, indexing
+  // threaded code table in data memory 0..127 OP_CALL prefix.
+  //
+  // Kernel inner may be configured for tail call optimization.
+  //
+  // Kernel operations are documented according to ANSI X3.215-1994,
+  // American National Standard for Information Systems, Programming
+  // Languages - Forth, March 24, 1994.
+  if (!TRACE) {
+    while ((ir = fetch_byte(ip++)) < 0) {
+      PROFILE(KERNEL_MAX + MAP(ir));
+      GRAPH_NEST(KERNEL_MAX + MAP(ir));
+#if (FVM_KERNEL_OPT == 1)
+      if (fetch_byte(ip)) *++rp = ip;
+#else
+      *++rp = ip;
+#endif
+      ip = FNTAB(MAP(ir));
+      FUEL(true);
+    }
+    PROFILE(ir);
+    goto DISPATCH;
+  }
+
+#if (FVM_TRACE == 3)
+  // Binary trace; write record to ring buffer before each
+  // instruction. Prefixed tokens are recorded with the full token
+  do {
+    ir = fetch_byte(ip);
+    if (task.m_trace && trace_filter(task, ip, rp - task.m_rp0)) {
+      trace_t* tr = &s_trace[s_trace_count++ & (TRACE_MAX - 1)];
+      tr->task = &task;
+      tr->ip = ip;
+      tr->time = micros();
+      tr->token = trace_token(ip);
+      tr->depth = rp - task.m_rp0;
+      SPILL_NOS();
+      tr->size = sp - task.m_sp0;
+      FILL_NOS();
+      tr->tos = tos;
+    }
+    ip += 1;
+    if (ir < 0) {
+      PROFILE(KERNEL_MAX + MAP(ir));
+      GRAPH_NEST(KERNEL_MAX + MAP(ir));
+      NEST();
+      ip = FNTAB(MAP(ir));
+      FUEL(true);
+    }
+  } while (ir < 0);
+  PROFILE(ir);
+
+#elif (FVM_TRACE != 0)
+  // Trace execution; micro-seconds, instruction pointer,
+  // return stack depth, token, and stack contents
+  do {
+    bool traced = task.m_trace && trace_filter(task, ip, rp - task.m_rp0);
+    if (traced) {
+#if (FVM_TRACE == 2)
+      uint32_t stop = micros();
+#endif
+      ios.print(F("task@"));
+      ios.print((uintptr_t) &task);
+      ios.print(':');
+#if (FVM_TRACE == 2)
+      // Print measurement of latest operation; micro-seconds
+      ios.print(stop - start);
+      ios.print(':');
+      // Print current instruction pointer
+      ios.print((uintptr_t) ip);
+      ios.print(':');
+      // Print current return stack depth
+      ios.print((uint16_t) (rp - task.m_rp0));
       ios.print(':');
 #else
       // Print leading spaces, indent, with return stack depth
@@ -219,13 +1483,16 @@ int FVM::resume(task_t& task)
     // Print name or token
     ir = fetch_byte(ip++);
     if (ir < 0 ) {
+      PROFILE(KERNEL_MAX + MAP(ir));
+      GRAPH_NEST(KERNEL_MAX + MAP(ir));
 #if (FVM_KERNEL_OPT == 1)
       if (fetch_byte(ip)) *++rp = ip;
 #else
       *++rp = ip;
 #endif
       ip = FNTAB(MAP(ir));
-      if (task.m_trace) {
+      FUEL(true);
+      if (traced) {
 #if (FVM_KERNEL_DICT == 0)
 	ios.print(KERNEL_MAX-ir-1);
 #else
@@ -233,7 +1500,7 @@ int FVM::resume(task_t& task)
 #endif
       }
     }
-    else if (task.m_trace) {
+    else if (traced) {
 #if (FVM_KERNEL_DICT == 0)
       ios.print(ir);
 #else
@@ -248,7 +1515,8 @@ int FVM::resume(task_t& task)
 #endif
     }
     // Print stack contents
-    if (task.m_trace) {
+    if (traced) {
+      SPILL_NOS();
       tmp = (sp - task.m_sp0);
       ios.print(F(":["));
       ios.print(tmp);
@@ -262,13 +1530,15 @@ int FVM::resume(task_t& task)
 	ios.print(tos);
       }
       ios.println();
-    }
-    // Flush output and start measurement
-    ios.flush();
+      FILL_NOS();
+      // Flush output and start measurement
+      ios.flush();
 #if (FVM_TRACE == 2)
-    if (task.m_trace) start = micros();
+      start = micros();
 #endif
+    }
   } while (ir < 0);
+  PROFILE(ir);
 #endif
 
   // Dispatch instruction; primitive or internal threaded code call
@@ -279,20 +1549,21 @@ DISPATCH:
   // Exit from call if zero/false.
   OP(ZERO_EXIT)
     tmp = tos;
-    tos = *sp--;
+    POP();
     if (tmp != 0) NEXT();
   FALLTHROUGH();
 
   // exit ( -- ) ( R: nest-sys -- )
   // Return control to the calling definition specified by nest-sys.
   OP(EXIT)
+    GRAPH_UNNEST();
     ip = *rp--;
   NEXT();
 
   // (lit) ( -- x )
   // Push literal data (little-endian).
   OP(LIT)
-    *++sp = tos;
+    PUSH();
     tos = (uint8_t) fetch_byte(ip++);
     tos |= (fetch_byte(ip++) << 8);
   NEXT();
@@ -300,27 +1571,37 @@ DISPATCH:
   // (clit) ( -- x )
   // Push literal data (signed byte).
   OP(CLIT)
-    *++sp = tos;
+    PUSH();
     tos = fetch_byte(ip++);
   NEXT();
 
+  // (wlit) ( -- x )
+  // Push literal data (cell width, little-endian).
+  OP(WLIT)
+    PUSH();
+    tos = fetch_word(ip);
+    ip += sizeof(cell_t);
+  NEXT();
+
   // (var) ( -- addr )
   // Push address of variable (pointer to cell).
   OP(VAR)
-    *++sp = tos;
+    PUSH();
 #if defined(ARDUINO_ARCH_AVR)
     tos = (cell_t) (ip - CODE_P_MAX);
 #else
-    tos = (cell_t) ip;
+    tos = address(ip);
 #endif
+    GRAPH_UNNEST();
     ip = *rp--;
   NEXT();
 
   // (const) ( -- value )
   // Push value of contant.
   OP(CONST)
-    *++sp = tos;
+    PUSH();
     tos = fetch_word(ip);
+    GRAPH_UNNEST();
     ip = *rp--;
   NEXT();
 
@@ -328,15 +1609,22 @@ DISPATCH:
   // Call extension function wrapper.
   OP(FUNC)
   {
+#if defined(ARDUINO_ARCH_AVR)
     void* env = (void*) fetch_word(ip + sizeof(fn_t));
     fn_t fn = (fn_t) fetch_word(ip);
-    *++sp = tos;
+#else
+    void* env = *((void**) (ip + sizeof(fn_t)));
+    fn_t fn = *((fn_t*) ip);
+#endif
+    LOOP_SPILL();
+    SPILL();
     task.m_sp = sp;
     task.m_rp = rp;
     fn(task, env);
     rp = task.m_rp;
     sp = task.m_sp;
-    tos = *sp--;
+    FILL();
+    GRAPH_UNNEST();
     ip = *rp--;
   }
   NEXT();
@@ -344,7 +1632,8 @@ DISPATCH:
   // (does) ( -- addr )
   // Push object pointer accessed by return address.
   OP(DOES)
-    *++sp = tos;
+    PUSH();
+    GRAPH_UNNEST();
     tp = *rp--;
 #if defined(ARDUINO_ARCH_AVR)
     tos = fetch_word(tp + 1);
@@ -356,22 +1645,24 @@ DISPATCH:
   // (param) ( xn..x0 -- xn..x0 xi )
   // Duplicate inline index stack element to top of stack.
   OP(PARAM)
-    *++sp = tos;
     ir = fetch_byte(ip++);
+    SPILL();
     tos = *(sp - ir);
+    FILL_NOS();
   NEXT();
 
   // (slit) ( -- addr )
   // Push pointer to literal and branch.
   OP(SLIT)
-    *++sp = tos;
-    tos = (cell_t) ip + 1;
+    PUSH();
+    tos = address(ip + 1);
 
   // (branch) ( -- )
   // Branch always (8-bit offset, -128..127).
   OP(BRANCH)
     ir = fetch_byte(ip);
     ip += ir;
+    FUEL(ir < 0);
   NEXT();
 
   // (0branch) ( flag -- )
@@ -379,7 +1670,8 @@ DISPATCH:
   OP(ZERO_BRANCH)
     ir = fetch_byte(ip);
     ip += (tos == 0) ? ir : 1;
-    tos = *sp--;
+    POP();
+    FUEL(ir < 0);
   NEXT();
 
   // (do) ( n1|u1 n2|u2 -- ) ( R: -- loop-sys )
@@ -388,17 +1680,17 @@ DISPATCH:
   // both the same type. Anything already on the return stack becomes
   // unavailable until the loop-control parameters are discarded.
   OP(DO)
-    tmp = *sp--;
+    tmp = NOS;
+    POP_NOS();
     if (tos < tmp) {
-      *++rp = (code_t*) tmp;
-      *++rp = (code_t*) tos;
+      LOOP_ENTER(tos, tmp);
       ip += 1;
     }
     else {
       ir = fetch_byte(ip);
       ip += ir;
     }
-    tos = *sp--;
+    POP();
   NEXT();
 
   // j ( -- n|u ) ( R: loop-sys1 loop-sys2 -- loop-sys1 loop-sys2 )
@@ -406,14 +1698,16 @@ DISPATCH:
   // condition exists if the loop control parameters of the next-outer
   // loop, loop-sys1, are unavailable.
   OP(J)
-    *++sp = tos;
-    tos = (cell_t) *(rp - 2);
+    PUSH();
+    tos = RCELL(*(rp - 2));
   NEXT();
 
   // leave ( -- rp: high high )
   // Mark loop block as completed.
   OP(LEAVE)
-    *rp = *(rp - 1);
+    LOOP_FILL();
+    li = ll;
+    LOOP_STORE();
   NEXT();
 
   // (loop) ( -- ) ( R: loop-sys1 -- | loop-sys2 )
@@ -423,13 +1717,16 @@ DISPATCH:
   // execution immediately following the loop. Otherwise continue
   // execution at the beginning of the loop.
   OP(LOOP)
-    *rp += 1;
-    if (*rp < *(rp - 1)) {
+    LOOP_FILL();
+    li += 1;
+    if ((ucell_t) li < (ucell_t) ll) {
+      LOOP_STORE();
       ir = fetch_byte(ip);
       ip += ir;
+      FUEL(true);
     }
     else {
-      rp -= 2;
+      LOOP_EXIT();
       ip += 1;
     }
   NEXT();
@@ -441,16 +1738,53 @@ DISPATCH:
   // discard the current loop control parameters and continue
   // execution immediately following the loop.
   OP(PLUS_LOOP)
-    *rp += tos;
-    if (*rp < *(rp - 1)) {
+    LOOP_FILL();
+    li += tos;
+    POP();
+    if ((ucell_t) li < (ucell_t) ll) {
+      LOOP_STORE();
+      ir = fetch_byte(ip);
+      ip += ir;
+      FUEL(true);
+    }
+    else {
+      LOOP_EXIT();
+      ip += 1;
+    }
+  NEXT();
+
+  // (for) ( n -- ) ( R: -- loop-sys )
+  // Set up down counting loop control parameters with index n-1 and
+  // limit zero. The loop block is skipped when n is less than one.
+  OP(FOR)
+    if (tos > 0) {
+      LOOP_ENTER(tos - 1, 0);
+      ip += 1;
+    }
+    else {
+      ir = fetch_byte(ip);
+      ip += ir;
+    }
+    POP();
+  NEXT();
+
+  // (next) ( -- ) ( R: loop-sys1 -- | loop-sys2 )
+  // Subtract one from the loop index. If the loop index is then
+  // negative, discard the loop parameters and continue execution
+  // immediately following the loop. Otherwise continue execution at
+  // the beginning of the loop.
+  OP(NEXT)
+    LOOP_FILL();
+    if (--li >= 0) {
+      LOOP_STORE();
       ir = fetch_byte(ip);
       ip += ir;
+      FUEL(true);
     }
     else {
-      rp -= 2;
+      LOOP_EXIT();
       ip += 1;
     }
-    tos = *sp--;
   FALLTHROUGH();
 
   // noop ( -- )
@@ -462,43 +1796,151 @@ DISPATCH:
   // Remove xt from the stack and perform the semantics identified by
   // it. Other stack effects are due to the semantics of the token.
   OP(EXECUTE)
+    PROFILE(tos & TOKEN_MAX);
     if (tos < KERNEL_MAX) {
       ir = tos;
-      tos = *sp--;
+      POP();
       goto DISPATCH;
     }
     else if (tos < APPLICATION_MAX) {
+      GRAPH_NEST(tos);
       *++rp = ip;
       ip = FNTAB(tos-KERNEL_MAX);
-      tos = *sp--;
+      POP();
+      FUEL(true);
     }
     else {
+      GRAPH_NEST(tos & TOKEN_MAX);
       *++rp = ip;
+#if (FVM_CACHE == 1)
+      tmp = tos - APPLICATION_MAX;
+      POP();
+      goto XENTER;
+#else
       ip = (code_P) m_body[tos - APPLICATION_MAX];
-      tos = *sp--;
+      POP();
+      FUEL(true);
+#endif
     }
   NEXT();
 
   // halt ( -- )
   // Halt virtual machine. Do not proceed on resume.
   OP(HALT)
+#if (FVM_PROFILER == 2)
+    graph_halt(task);
+#endif
     rp = task.m_rp0;
+    LOOP_RESET();
     ip -= 1;
   FALLTHROUGH();
 
   // yield ( -- )
   // Yield virtual machine. Proceed on resume.
   OP(YIELD)
-    *++sp = tos;
+    LOOP_SPILL();
+    SPILL();
     *++rp = ip;
     task.m_sp = sp;
     task.m_rp = rp;
+    PROFILE_LEAVE();
   return (ir == OP_YIELD);
 
+#if (FVM_FUEL == 1)
+  // Preempt when the instruction budget is used. Proceed on resume.
+ PREEMPT:
+    LOOP_SPILL();
+    SPILL();
+    *++rp = ip;
+    task.m_sp = sp;
+    task.m_rp = rp;
+    PROFILE_LEAVE();
+  return (2);
+#endif
+
+  // Yield when buffered output could not be drained. Proceed on
+  // resume.
+ OUTPUT_BLOCKED:
+    LOOP_SPILL();
+    SPILL();
+    *++rp = ip;
+    task.m_sp = sp;
+    task.m_rp = rp;
+    PROFILE_LEAVE();
+  return (1);
+
   // (syscall) ( -- )
-  // System call token (0..255); compiled code.
+  // System call token (0..255); compiled code. Branch operations
+  // with the prefix have a long offset (16-bit, -32768..32767).
   OP(SYSCALL)
     ir = fetch_byte(ip++);
+    PROFILE((uint8_t) ir);
+    switch (ir) {
+    case OP_BRANCH:
+      tmp = fetch_offset(ip);
+      ip += tmp;
+      FUEL(tmp < 0);
+      NEXT();
+    case OP_ZERO_BRANCH:
+      tmp = fetch_offset(ip);
+      ip += (tos == 0) ? tmp : 2;
+      POP();
+      FUEL(tmp < 0);
+      NEXT();
+    case OP_DO:
+      tmp = NOS;
+      POP_NOS();
+      if (tos < tmp) {
+	LOOP_ENTER(tos, tmp);
+	ip += 2;
+      }
+      else {
+	ip += fetch_offset(ip);
+      }
+      POP();
+      NEXT();
+    case OP_PLUS_LOOP:
+      LOOP_FILL();
+      li += tos - 1;
+      LOOP_STORE();
+      POP();
+      FALLTHROUGH();
+    case OP_LOOP:
+      LOOP_FILL();
+      li += 1;
+      if ((ucell_t) li < (ucell_t) ll) {
+	LOOP_STORE();
+	ip += fetch_offset(ip);
+	FUEL(true);
+      }
+      else {
+	LOOP_EXIT();
+	ip += 2;
+      }
+      NEXT();
+    case OP_FOR:
+      if (tos > 0) {
+	LOOP_ENTER(tos - 1, 0);
+	ip += 2;
+      }
+      else {
+	ip += fetch_offset(ip);
+      }
+      POP();
+      NEXT();
+    case OP_NEXT:
+      LOOP_FILL();
+      if (--li >= 0) {
+	LOOP_STORE();
+	ip += fetch_offset(ip);
+	FUEL(true);
+      }
+      else {
+	LOOP_EXIT();
+	ip += 2;
+      }
+      NEXT();
+    }
   goto DISPATCH;
 
   // (call) ( -- )
@@ -506,35 +1948,72 @@ DISPATCH:
   // are mapped to 0..127.
   OP(CALL)
     tmp = (uint8_t) fetch_byte(ip++);
+    PROFILE(APPLICATION_MAX + tmp);
+    GRAPH_NEST(APPLICATION_MAX + tmp);
 #if (FVM_KERNEL_OPT == 1)
       if (fetch_byte(ip)) *++rp = ip;
 #else
       *++rp = ip;
+#endif
+#if (FVM_CACHE == 1)
+  XENTER:
+    if (!TRACE && m_xcode[tmp] == 0) translate(tmp, xtab);
+    if (!TRACE && m_xcode[tmp] != XCODE_NONE) {
+      *++rp = (code_P) XRET;
+      xp = m_xcode[tmp];
+      XFUEL(true);
+      XNEXT();
+    }
 #endif
     ip = (code_P) m_body[tmp];
+    FUEL(true);
   NEXT();
 
   // trace ( flag -- )
   // Set trace mode.
   OP(TRACE)
+    task.m_out.flush();
     task.m_trace = tos;
-    tos = *sp--;
+    POP();
+#if (FVM_TRACE != 0) && !defined(ARDUINO_ARCH_AVR)
+    if (TRACED(task, rp) == TRACE) NEXT();
+
+  // Trace mode changed; resume with the other inner interpreter.
+#if (FVM_CACHE == 1)
+  TRACE_CHANGED:
+#endif
+    LOOP_SPILL();
+    SPILL();
+    *++rp = ip;
+    task.m_sp = sp;
+    task.m_rp = rp;
+    PROFILE_LEAVE();
+    return (TRACE_SWITCH);
+#else
+  NEXT();
+#endif
+
+  // trace-filter ( token min max n -- )
+  // Set trace filter; trace only within call of token (zero for
+  // all), return stack depth min..max and every nth instruction.
+  OP(TRACE_FILTER)
+    SPILL();
+    task.trace_filter(sp[-3], sp[-2], sp[-1], sp[0]);
+    sp -= 4;
+    FILL();
   NEXT();
 
   // room ( -- n bytes )
   // Number of free dictionary entries and bytes.
   OP(ROOM)
-    *++sp = tos;
-    *++sp = WORD_MAX - m_next;
-    tos = DICT_MAX - (m_dp - (uint8_t*) m_body);
-  NEXT();
+    COLD();
 
   // c@ ( c-addr -- char )
   // Fetch the character stored at c-addr. When the cell size is
   // greater than character size, the unused high-order bits are all
   // zeroes.
   OP(C_FETCH)
-    tos = *((uint8_t*) tos);
+    tos = *((uint8_t*) pointer(tos));
   NEXT();
 
   // c! ( char c-addr -- )
@@ -542,29 +2021,32 @@ DISPATCH:
   // size, only the number of low-order bits corresponding to
   // character size are transferred.
   OP(C_STORE)
-    *((uint8_t*) tos) = *sp--;
-    tos = *sp--;
+    *((uint8_t*) pointer(tos)) = NOS;
+    POP_NOS();
+    POP();
   NEXT();
 
   // @ ( a-addr -- x )
   // x is the value stored at a-addr.
   OP(FETCH)
-    tos = *((cell_t*) tos);
+    tos = *((cell_t*) pointer(tos));
   NEXT();
 
   // ! ( x a-addr -- )
   // Store x at a-addr.
   OP(STORE)
-    *((cell_t*) tos) = *sp--;
-    tos = *sp--;
+    *((cell_t*) pointer(tos)) = NOS;
+    POP_NOS();
+    POP();
   NEXT();
 
   // +! ( n|u a-addr -- )
   // Add n|u to the single-cell number at a-addr.
   OP(PLUS_STORE)
-#if 0
-    *((cell_t*) tos) += *sp--;
-    tos = *sp--;
+#if (FVM_CPP_PLUS_STORE == 1)
+    *((cell_t*) pointer(tos)) += NOS;
+    POP_NOS();
+    POP();
   NEXT();
 #else
   // : +! ( n|u a-addr -- ) dup >r @ + r> ! ;
@@ -581,18 +2063,19 @@ DISPATCH:
 #endif
 
   // dp ( -- a-addr )
-  // Push address to data-space pointer.
+  // Push address to data-space pointer. The data-space pointer is a
+  // native pointer; use here and allot.
   OP(DP)
-    *++sp = tos;
-    tos = (cell_t) &m_dp;
+    PUSH();
+    tos = address(&m_dp);
   NEXT();
 
   // here ( -- a-addr )
   // a-addr is the data-space pointer.
   OP(HERE)
-#if 0
-    *++sp = tos;
-    tos = (cell_t) m_dp;
+#if (FVM_CPP_HERE == 1)
+    PUSH();
+    tos = address(m_dp);
   NEXT();
 #else
   // : here ( -- addr ) dp @ ;
@@ -609,9 +2092,9 @@ DISPATCH:
   // space. If n is less than zero, release |n| address units of data
   // space. If n is zero, leave the data-space pointer unchanged.
   OP(ALLOT)
-#if 0
+#if (FVM_CPP_ALLOT == 1)
     m_dp += tos;
-    tos = *sp--;
+    POP();
   NEXT();
 #else
   // : allot ( n -- ) dp +! ;
@@ -626,10 +2109,10 @@ DISPATCH:
   // , ( x -- )
   // Reserve one cell of data space and store x in the cell.
   OP(COMMA)
-#if 0
+#if (FVM_CPP_COMMA == 1)
     *((cell_t*) m_dp) = tos;
     m_dp += sizeof(cell_t);
-    tos = *sp--;
+    POP();
   NEXT();
 #else
   // : , ( x -- ) here ! cell allot ;
@@ -647,9 +2130,9 @@ DISPATCH:
   // Reserve space for one character in the data space and store char
   // in the space.
   OP(C_COMMA)
-#if 0
+#if (FVM_CPP_C_COMMA == 1)
     *m_dp++ = tos;
-    tos = *sp--;
+    POP();
   NEXT();
 #else
   // : c, ( x -- ) here c! 1 allot ;
@@ -672,15 +2155,16 @@ DISPATCH:
   // >r ( x -- ) ( R: -- x )
   // Move x to the return stack.
   OP(TO_R)
-    *++rp = (code_t*) tos;
-    tos = *sp--;
+    *++rp = RCODE(tos);
+    POP();
   NEXT();
 
   // r> ( -- x ) ( R: x -- )
   // Move x from the return stack to the data stack.
   OP(R_FROM)
-    *++sp = tos;
-    tos = (cell_t) *rp--;
+    PUSH();
+    LOOP_POP();
+    tos = RCELL(*rp--);
   NEXT();
 
   // i ( -- n|u ) ( R: loop-sys -- loop-sys )
@@ -692,37 +2176,40 @@ DISPATCH:
   // r@ ( -- x ) ( R: x -- x )
   // Copy x from the return stack to the data stack.
   OP(R_FETCH)
-    *++sp = tos;
-    tos = (cell_t) *rp;
+    PUSH();
+    tos = LOOP_INDEX();
   NEXT();
 
   // sp ( -- addr )
   // Push stack pointer.
   OP(SP)
-    *++sp = tos;
-    tos = (cell_t) sp;
+    SPILL();
+    tos = address(sp);
+    FILL_NOS();
   NEXT();
 
   // depth ( -- +n )
   // +n is the number of single-cell values contained in the data
   // stack before +n was placed on the stack.
   OP(DEPTH)
+    SPILL_NOS();
     tmp = (sp - task.m_sp0);
-    *++sp = tos;
+    FILL_NOS();
+    PUSH();
     tos = tmp;
   NEXT();
 
   // drop ( x -- )
   // Remove x from the stack.
   OP(DROP)
-    tos = *sp--;
+    POP();
   NEXT();
 
   // nip ( x1 x2 -- x2 )
   // Drop the first item below the top of stack.
   OP(NIP)
-#if 1
-    sp -= 1;
+#if (FVM_CPP_NIP == 1)
+    POP_NOS();
   NEXT();
 #else
   // : nip ( x1 x2 -- x2 ) swap drop ;
@@ -738,13 +2225,14 @@ DISPATCH:
   // Empty data stack.
   OP(EMPTY)
     sp = task.m_sp0;
+    FILL_NOS();
   NEXT();
 
   // dup ( x -- x x )
   // Duplicate x.
   OP(DUP)
-#if 1
-    *++sp = tos;
+#if (FVM_CPP_DUP == 1)
+    PUSH();
   NEXT();
 #else
   // : dup ( x -- x x ) param: 0  ;
@@ -758,8 +2246,8 @@ DISPATCH:
   // ?dup ( x -- 0 | x x )
   // Duplicate x if it is non-zero.
   OP(QUESTION_DUP)
-#if 1
-    if (tos != 0) *++sp = tos;
+#if (FVM_CPP_QUESTION_DUP == 1)
+    if (tos != 0) PUSH();
   NEXT();
 #else
   // : ?dup ( x -- 0 | x x ) dup ?exit dup ;
@@ -775,9 +2263,9 @@ DISPATCH:
   // over ( x1 x2 -- x1 x2 x1 )
   // Place a copy of x 1 on top of the stack.
   OP(OVER)
-#if 1
-    tmp = *sp;
-    *++sp = tos;
+#if (FVM_CPP_OVER == 1)
+    tmp = NOS;
+    PUSH();
     tos = tmp;
   NEXT();
 #else
@@ -792,10 +2280,11 @@ DISPATCH:
   // tuck ( x1 x2 -- x2 x1 x2 )
   // Copy the first (top) stack item below the second stack item.
   OP(TUCK)
-#if 0
-    tmp = *sp;
-    *sp = tos;
-    *++sp = tmp;
+#if (FVM_CPP_TUCK == 1)
+    tmp = NOS;
+    NOS = tos;
+    PUSH();
+    NOS = tmp;
   NEXT();
 #else
   // : tuck ( x1 x2 -- x2 x1 x2 ) swap over ;
@@ -810,16 +2299,18 @@ DISPATCH:
   // pick ( xn..x0 i -- xn..x0 xi )
   // Duplicate index stack element to top of stack.
   OP(PICK)
+    SPILL_NOS();
     tos = *(sp - tos);
+    FILL_NOS();
   NEXT();
 
   // swap ( x1 x2 -- x2 x1 )
   // Exchange the top two stack items.
   OP(SWAP)
-#if 1
+#if (FVM_CPP_SWAP == 1)
     tmp = tos;
-    tos = *sp;
-    *sp = tmp;
+    tos = NOS;
+    NOS = tmp;
   NEXT();
 #else
   // : swap ( x1 x2 -- x2 x1 ) 1 roll ;
@@ -834,11 +2325,11 @@ DISPATCH:
   // rot ( x1 x2 x3 -- x2 x3 x1 )
   // Rotate the top three stack entries.
   OP(ROT)
-#if 1
+#if (FVM_CPP_ROT == 1)
     tmp = tos;
-    tos = *(sp - 1);
-    *(sp - 1) = *sp;
-    *sp = tmp;
+    tos = THIRD;
+    THIRD = NOS;
+    NOS = tmp;
   NEXT();
 #else
   // : rot ( x1 x2 x3 -- x2 x3 x1 ) 2 roll ;
@@ -853,11 +2344,11 @@ DISPATCH:
   // -rot ( x1 x2 x3 -- x3 x1 x2 )
   // Rotate down top three stack elements.
   OP(MINUS_ROT)
-#if 0
+#if (FVM_CPP_MINUS_ROT == 1)
     tmp = tos;
-    tos = *sp;
-    *sp = *(sp - 1);
-    *(sp - 1) = tmp;
+    tos = NOS;
+    NOS = THIRD;
+    THIRD = tmp;
   NEXT();
 #else
   // : -rot ( x1 x2 x3 -- x3 x1 x2 ) rot rot ;
@@ -872,11 +2363,13 @@ DISPATCH:
   // roll ( xn..x0 n -- xn-1..x0 xn )
   // Rotate up n+1 stack elements.
   OP(ROLL)
+    SPILL_NOS();
     tmp = tos;
     tos = sp[-tmp];
     for (; tmp > 0; tmp--)
       sp[-tmp] = sp[-tmp + 1];
     sp -= 1;
+    FILL_NOS();
   NEXT();
 
   // 2swap ( x1 x2 x3 x4 -- x3 x4 x1 x2 )
@@ -928,7 +2421,7 @@ DISPATCH:
   // -2 ( -- -2 )
   // Constant -2.
   OP(MINUS_TWO)
-    *++sp = tos;
+    PUSH();
     tos = -2;
   NEXT();
 
@@ -940,7 +2433,7 @@ DISPATCH:
   // TRUE ( -- -1 )
   // Constant true (alias -1).
   OP(TRUE)
-    *++sp = tos;
+    PUSH();
     tos = -1;
   NEXT();
 
@@ -952,35 +2445,35 @@ DISPATCH:
   // FALSE ( -- 0 )
   // Constant false.
   OP(FALSE)
-    *++sp = tos;
+    PUSH();
     tos = 0;
   NEXT();
 
   // 1 ( -- 1 )
   // Constant 1.
   OP(ONE)
-    *++sp = tos;
+    PUSH();
     tos = 1;
   NEXT();
 
   // 2 ( -- 2 )
   // Constant 2.
   OP(TWO)
-    *++sp = tos;
+    PUSH();
     tos = 2;
   NEXT();
 
   // cell ( -- n )
   // Size of data element in bytes.
   OP(CELL)
-    *++sp = tos;
+    PUSH();
     tos = sizeof(cell_t);
   NEXT();
 
   // cells ( x -- y )
   // Convert cells to bytes for allot.
   OP(CELLS)
-#if 1
+#if (FVM_CPP_CELLS == 1)
     tos *= sizeof(cell_t);
   NEXT();
 #else
@@ -1002,25 +2495,28 @@ DISPATCH:
   // and ( x1 x2 -- x3 )
   // x3 is the bit-by-bit logical “and” of x1 with x2.
   OP(AND)
-    tos = *sp-- & tos;
+    tos = NOS & tos;
+    POP_NOS();
   NEXT();
 
   // or ( x1 x2 -- x3 )
   // x3 is the bit-by-bit inclusive-or of x1 with x2.
   OP(OR)
-    tos = *sp-- | tos;
+    tos = NOS | tos;
+    POP_NOS();
   NEXT();
 
   // xor ( x1 x2 -- x3 )
   // x3 is the bit-by-bit exclusive-or of x1 with x2.
   OP(XOR)
-    tos = *sp-- ^ tos;
+    tos = NOS ^ tos;
+    POP_NOS();
   NEXT();
 
   // negate ( n1 -- n2 )
   // Negate n1, giving its arithmetic inverse n2.
   OP(NEGATE)
-#if 1
+#if (FVM_CPP_NEGATE == 1)
     tos = -tos;
   NEXT();
 #else
@@ -1076,19 +2572,22 @@ DISPATCH:
   // + ( n1|u1 n2|u2 -- n3|u3 )
   // Add n2|u2 to n1|u1, giving the sum n3|u3.
   OP(PLUS)
-    tos = *sp-- + tos;
+    tos = NOS + tos;
+    POP_NOS();
   NEXT();
 
   // - ( n1|u1 n2|u2 -- n3|u3 )
   // Subtract n2|u2 from n1|u1, giving the difference n3|u3.
   OP(MINUS)
-    tos = *sp-- - tos;
+    tos = NOS - tos;
+    POP_NOS();
   NEXT();
 
   // * ( n1|u1 n2|u2 -- n3|u3 )
   // Multiply n1|u1 by n2|u2 giving the product n3|u3.
   OP(STAR)
-    tos = *sp-- * tos;
+    tos = NOS * tos;
+    POP_NOS();
   NEXT();
 
   // */ ( n1 n2 n3 -- n4 )
@@ -1097,22 +2596,25 @@ DISPATCH:
   // ambiguous condition exists if n3 is zero or if the quotient n4
   // lies outside the range of a signed number.
   OP(STAR_SLASH)
-    tmp = *sp--;
-    tos = (((cell2_t) tmp) * (*sp--)) / tos;
+    tos = (((cell2_t) THIRD) * NOS) / tos;
+    POP_NOS();
+    POP_NOS();
   NEXT();
 
   // / ( n1 n2 -- n3 )
   // Divide n1 by n2, giving the single-cell quotient n3. An
   // ambiguous condition exists if n2 is zero.
   OP(SLASH)
-    tos = *sp-- / tos;
+    tos = NOS / tos;
+    POP_NOS();
   NEXT();
 
   // mod ( n1 n2 -- n3 )
   // Divide n1 by n2, giving the single-cell remainder n3. An
   // ambiguous condition exists if n2 is zero.
   OP(MOD)
-    tos = *sp-- % tos;
+    tos = NOS % tos;
+    POP_NOS();
   NEXT();
 
   // /mod ( n1 n2 -- n3 n4 )
@@ -1120,9 +2622,9 @@ DISPATCH:
   // single-cell quotient n4. An ambiguous condition exists if n2 is
   // zero.
   OP(SLASH_MOD)
-    tmp = *sp / tos;
-    tos = *sp % tos;
-    *sp = tmp;
+    tmp = NOS / tos;
+    tos = NOS % tos;
+    NOS = tmp;
   NEXT();
 
   // lshift ( x1 u -- x2 )
@@ -1131,7 +2633,8 @@ DISPATCH:
   // shift. An ambiguous condition exists if u is greater than or
   // equal to the number of bits in a cell.
   OP(LSHIFT)
-    tos = *sp-- << tos;
+    tos = NOS << tos;
+    POP_NOS();
   NEXT();
 
   // rshift ( x1 u -- x2 )
@@ -1140,7 +2643,8 @@ DISPATCH:
   // shift. An ambiguous condition exists if u is greater than or
   // equal to the number of bits in a cell.
   OP(RSHIFT)
-    tos = *sp-- >> tos;
+    tos = NOS >> tos;
+    POP_NOS();
   NEXT();
 
   // within ( n1|u1 n2|u2 n3|u3 -- flag )
@@ -1150,18 +2654,18 @@ DISPATCH:
   // and (n2|u2 <= n1|u1 or n1|u1 < n3|u3)) is true, returning false
   // otherwise.
   OP(WITHIN)
-#if 0
-    tmp = *sp--;
-    tos = ((*sp <= tos) & (*sp >= tmp)) ? -1 : 0;
-    sp--;
+#if (FVM_CPP_WITHIN == 1)
+    tmp = NOS;
+    POP_NOS();
+    tos = ((NOS <= tos) & (NOS >= tmp)) ? -1 : 0;
+    POP_NOS();
   NEXT();
 #else
-  // : within ( n1|u1 n2|u2 n3|u3 -- flag ) >r over swap < swap r> > or not ;
+  // : within ( n1|u1 n2|u2 n3|u3 -- flag ) >r over > swap r> > or not ;
   static const code_t WITHIN_CODE[] PROGMEM = {
     FVM_OP(TO_R),
     FVM_OP(OVER),
-    FVM_OP(SWAP),
-    FVM_OP(LESS),
+    FVM_OP(GREATER),
     FVM_OP(SWAP),
     FVM_OP(R_FROM),
     FVM_OP(GREATER),
@@ -1175,7 +2679,7 @@ DISPATCH:
   // abs ( n -- u )
   // u is the absolute value of n.
   OP(ABS)
-#if 0
+#if (FVM_CPP_ABS == 1)
     if (tos < 0) tos = -tos;
   NEXT();
 #elif 1
@@ -1189,13 +2693,12 @@ DISPATCH:
   };
   CALL(ABS_CODE);
 #else
-  // : abs ( n -- u ) dup 0< swap over + xor ;
+  // : abs ( n -- u ) dup 0< swap over+ xor ;
   static const code_t ABS_CODE[] PROGMEM = {
     FVM_OP(DUP),
     FVM_OP(ZERO_LESS),
     FVM_OP(SWAP),
-    FVM_OP(OVER),
-    FVM_OP(PLUS),
+    FVM_OP(OVER_PLUS),
     FVM_OP(XOR),
     FVM_OP(EXIT)
   };
@@ -1205,8 +2708,9 @@ DISPATCH:
   // min ( n1 n2 -- n3 )
   // n3 is the lesser of n1 and n2.
   OP(MIN)
-#if 0
-    tmp = *sp--;
+#if (FVM_CPP_MIN == 1)
+    tmp = NOS;
+    POP_NOS();
     if (tmp < tos) tos = tmp;
   NEXT();
 #elif 0
@@ -1221,10 +2725,9 @@ DISPATCH:
   };
   CALL(MIN_CODE);
 #else
-  // : min ( n1 n2 -- n3 ) over - dup 0< and + ;
+  // : min ( n1 n2 -- n3 ) over- dup 0< and + ;
   static const code_t MIN_CODE[] PROGMEM = {
-    FVM_OP(OVER),
-    FVM_OP(MINUS),
+    FVM_OP(OVER_MINUS),
     FVM_OP(DUP),
     FVM_OP(ZERO_LESS),
     FVM_OP(AND),
@@ -1237,8 +2740,9 @@ DISPATCH:
   // max ( n1 n2 -- n3 )
   // n3 is the greater of n1 and n2.
   OP(MAX)
-#if 0
-    tmp = *sp--;
+#if (FVM_CPP_MAX == 1)
+    tmp = NOS;
+    POP_NOS();
     if (tmp > tos) tos = tmp;
   NEXT();
 #elif 0
@@ -1275,7 +2779,7 @@ DISPATCH:
   // 0<> ( x -- flag )
   // flag is true if and only if x is not equal to zero.
   OP(ZERO_NOT_EQUALS)
-#if 1
+#if (FVM_CPP_ZERO_NOT_EQUALS == 1)
     tos = (tos != 0) ? -1 : 0;
   NEXT();
 #else
@@ -1291,13 +2795,13 @@ DISPATCH:
   // 0< ( n -- flag )
   // flag is true if and only if n is less than zero.
   OP(ZERO_LESS)
-#if 1
+#if (FVM_CPP_ZERO_LESS == 1)
     tos = (tos < 0) ? -1 : 0;
   NEXT();
 #else
-  // : 0< ( n -- flag ) 15 rshift ;
+  // : 0< ( n -- flag ) [ 8 cells 1- ] literal rshift ;
   static const code_t ZERO_LESS_CODE[] PROGMEM = {
-    FVM_CLIT(15),
+    FVM_CLIT(sizeof(cell_t) * 8 - 1),
     FVM_OP(RSHIFT),
     FVM_OP(EXIT)
   };
@@ -1324,8 +2828,9 @@ DISPATCH:
   // <> ( x1 x2 -- flag )
   // flag is true if and only if x1 is not bit-for-bit the same as x2.
   OP(NOT_EQUALS)
-#if 0
-    tos = (*sp-- != tos) ? -1 : 0;
+#if (FVM_CPP_NOT_EQUALS == 1)
+    tos = (NOS != tos) ? -1 : 0;
+    POP_NOS();
   NEXT();
 #else
   // : <> ( x1 x2 -- flag ) - bool ;
@@ -1340,12 +2845,20 @@ DISPATCH:
   // < ( n1 n2 -- flag )
   // flag is true if and only if n1 is less than n2.
   OP(LESS)
-#if 0
-    tos = (*sp-- < tos) ? -1 : 0;
+#if (FVM_CPP_LESS == 1)
+    tos = (NOS < tos) ? -1 : 0;
+    POP_NOS();
   NEXT();
 #else
-  // : < ( n1 n2 -- flag ) - 0< ;
+  // : < ( n1 n2 -- flag ) 2dup xor 0< if drop 0< exit then - 0< ;
   static const code_t LESS_CODE[] PROGMEM = {
+    FVM_OP(TWO_DUP),
+    FVM_OP(XOR),
+    FVM_OP(ZERO_LESS),
+    FVM_OP(ZERO_BRANCH), 4,
+      FVM_OP(DROP),
+      FVM_OP(ZERO_LESS),
+      FVM_OP(EXIT),
     FVM_OP(MINUS),
     FVM_OP(ZERO_LESS),
     FVM_OP(EXIT)
@@ -1356,8 +2869,9 @@ DISPATCH:
   // = ( x1 x2 -- flag )
   // flag is true if and only if x1 is bit-for-bit the same as x2.
   OP(EQUALS)
-#if 0
-    tos = (*sp-- == tos) ? -1 : 0;
+#if (FVM_CPP_EQUALS == 1)
+    tos = (NOS == tos) ? -1 : 0;
+    POP_NOS();
   NEXT();
 #else
   // : = ( x1 x2 -- flag ) - 0= ;
@@ -1372,8 +2886,9 @@ DISPATCH:
   // > ( n1 n2 -- flag )
   // flag is true if and only if n1 is greater than n2.
   OP(GREATER)
-#if 0
-    tos = (*sp-- > tos) ? -1 : 0;
+#if (FVM_CPP_GREATER == 1)
+    tos = (NOS > tos) ? -1 : 0;
+    POP_NOS();
   NEXT();
 #else
   // : > ( n1 n2 -- flag ) - 0> ;
@@ -1388,14 +2903,67 @@ DISPATCH:
   // u< ( u1 u2 -- flag )
   // flag is true if and only if u1 is less than u2.
   OP(U_LESS)
-    tos = ((ucell_t) *sp-- < (ucell_t) tos) ? -1 : 0;
+    tos = ((ucell_t) NOS < (ucell_t) tos) ? -1 : 0;
+    POP_NOS();
+  NEXT();
+
+  // (dup0branch) ( flag -- flag )
+  // Branch zero equal/false and keep flag; dup (0branch).
+  OP(DUP_ZERO_BRANCH)
+    ir = fetch_byte(ip);
+    ip += (tos == 0) ? ir : 1;
+    FUEL(ir < 0);
+  NEXT();
+
+  // over+ ( n1 n2 -- n1 n3 )
+  // Add n1 to n2 giving the sum n3; over +.
+  OP(OVER_PLUS)
+    tos += NOS;
+  NEXT();
+
+  // over- ( n1 n2 -- n1 n3 )
+  // Subtract n1 from n2 giving the difference n3; over -.
+  OP(OVER_MINUS)
+    tos -= NOS;
+  NEXT();
+
+  // r@+ ( n1 -- n2 ) ( R: x -- x )
+  // Add x to n1 giving the sum n2; r@ +.
+  OP(R_FETCH_PLUS)
+    tos += LOOP_INDEX();
+  NEXT();
+
+  // r@- ( n1 -- n2 ) ( R: x -- x )
+  // Subtract x from n1 giving the difference n2; r@ -.
+  OP(R_FETCH_MINUS)
+    tos -= LOOP_INDEX();
+  NEXT();
+
+  // i@ ( -- x ) ( R: loop-sys -- loop-sys )
+  // x is the value stored at the loop index; i @.
+  OP(I_FETCH)
+    PUSH();
+    tos = *((cell_t*) pointer(LOOP_INDEX()));
+  NEXT();
+
+  // (clit+) ( n1 -- n2 )
+  // Add inline literal (signed byte) to n1 giving the sum n2; n +.
+  OP(CLIT_PLUS)
+    tos += fetch_byte(ip++);
+  NEXT();
+
+  // (clit=) ( x -- flag )
+  // flag is true if and only if x is equal to inline literal (signed
+  // byte); n =.
+  OP(CLIT_EQUALS)
+    tmp = fetch_byte(ip++);
+    tos = (tos == tmp) ? -1 : 0;
   NEXT();
 
   // lookup ( str -- n )
   // Lookup string in dictionary.
   OP(LOOKUP)
-    tos = lookup((const char*) tos);
-  NEXT();
+    COLD();
 
   // >body ( xt -- a-addr )
   // a-addr is the data-field address corresponding to xt. An
@@ -1408,29 +2976,8 @@ DISPATCH:
   // words ( -- )
   // Print words in dictionary.
   OP(WORDS)
-#if 0
-  {
-    const char* s;
-    int len;
-    int nr = 0;
-    for (int i = 0; (s = (const char*) OPSTR(i)) != 0; i++) {
-      len = ios.print((const __FlashStringHelper*) s);
-      if (++nr % 5 == 0)
-	ios.println();
-      else {
-	for (;len < 16; len++) ios.print(' ');
-      }
-    }
-    for (int i = 0; (s = (const char*) FNSTR(i)) != 0; i++) {
-      len = ios.print((const __FlashStringHelper*) s);
-      if (++nr % 5 == 0)
-	ios.println();
-      else {
-	for (;len < 16; len++) ios.print(' ');
-      }
-    }
-  }
-  NEXT();
+#if (FVM_CPP_WORDS == 1)
+    COLD();
 #else
   // : words ( -- )
   //   0 begin
@@ -1484,21 +3031,21 @@ DISPATCH:
   // a-addr is the address of a cell containing the current
   // number-conversion radix.
   OP(BASE)
-    *++sp = tos;
-    tos = (cell_t) &task.m_base;
+    PUSH();
+    tos = address(&task.m_base);
   NEXT();
 
   // hex ( -- )
   // Set the numeric conversion radix to sixteen (hexa-decimal).
   OP(HEX)
-#if 0
+#if (FVM_CPP_HEX == 1)
     task.m_base = 16;
   NEXT();
 #else
   // : hex ( -- ) 16 base ! ;
   static const code_t HEX_CODE[] PROGMEM = {
     FVM_CLIT(16),
-    FVM_OP(BASE),
+    FVM_SYSCALL(BASE),
     FVM_OP(STORE),
     FVM_OP(EXIT)
   };
@@ -1508,14 +3055,14 @@ DISPATCH:
   // decimal ( -- )
   // Set the numeric conversion radix to ten (decimal).
   OP(DECIMAL)
-#if 0
+#if (FVM_CPP_DECIMAL == 1)
     task.m_base = 10;
   NEXT();
 #else
   // : decimal ( -- ) 10 base ! ;
   static const code_t DECIMAL_CODE[] PROGMEM = {
     FVM_CLIT(10),
-    FVM_OP(BASE),
+    FVM_SYSCALL(BASE),
     FVM_OP(STORE),
     FVM_OP(EXIT)
   };
@@ -1525,9 +3072,11 @@ DISPATCH:
   // ?key ( -- c true | false )
   // Read character if available.
   OP(QUESTION_KEY)
-    *++sp = tos;
+    PUSH();
     if (ios.available()) {
-      *++sp = ios.read();
+      task.m_input = false;
+      tos = ios.read();
+      PUSH();
       tos = -1;
     }
     else {
@@ -1541,15 +3090,17 @@ DISPATCH:
   // such characters are discarded until a valid character is
   // received, and those events are subsequently unavailable. All
   // standard characters can be received. Characters
-  // received are not displayed.
+  // received are not displayed. The task is marked as waiting for
+  // input for the scheduler until ?key receives a character.
   OP(KEY)
+    task.m_input = true;
   // : key ( -- char ) begin ?key ?exit yield again ;
   static const code_t KEY_CODE[] PROGMEM = {
-      FVM_OP(QUESTION_KEY),
+      FVM_SYSCALL(QUESTION_KEY),
       FVM_OP(NOT),
       FVM_OP(ZERO_EXIT),
       FVM_OP(YIELD),
-    FVM_OP(BRANCH), -5,
+    FVM_OP(BRANCH), -6,
   };
   CALL(KEY_CODE);
 
@@ -1558,20 +3109,30 @@ DISPATCH:
   // character set, display x. The effect for all other values
   // of x is implementation-defined.
   OP(EMIT)
-    ios.print((char) tos);
-    tos = *sp--;
+    out.print((char) tos);
+    if (tos == '\n') {
+      POP();
+      FLUSH();
+    }
+    else {
+      POP();
+      DRAIN();
+    }
   NEXT();
 
   // cr ( -- )
   // Cause subsequent output to appear at the beginning of the next
   // line.
   OP(CR)
-#if 1
-    ios.println();
+#if (FVM_CPP_CR == 1)
+    out.println();
+    FLUSH();
   NEXT();
 #else
-  // : cr ( -- ) '\n' emit ;
+  // : cr ( -- ) '\r' emit '\n' emit ;
   static const code_t CR_CODE[] PROGMEM = {
+    FVM_CLIT('\r'),
+    FVM_OP(EMIT),
     FVM_CLIT('\n'),
     FVM_OP(EMIT),
     FVM_OP(EXIT)
@@ -1582,8 +3143,9 @@ DISPATCH:
   // space ( -- )
   // Display one space.
   OP(SPACE)
-#if 1
-    ios.print(' ');
+#if (FVM_CPP_SPACE == 1)
+    out.print(' ');
+    DRAIN();
   NEXT();
 #else
   // : space ( -- ) ' ' emit ;
@@ -1598,9 +3160,10 @@ DISPATCH:
   // spaces ( n -- )
   // If n is greater than zero, display n spaces.
   OP(SPACES)
-#if 0
-    while (tos-- > 0) ios.print(' ');
-    tos = *sp--;
+#if (FVM_CPP_SPACES == 1)
+    while (tos-- > 0) out.print(' ');
+    POP();
+    DRAIN();
   NEXT();
 #else
   // : spaces ( n -- ) 0 do space loop ;
@@ -1617,26 +3180,30 @@ DISPATCH:
   // u. ( u -- )
   // Display u in free field format.
   OP(U_DOT)
-    ios.print((ucell_t) tos, task.m_base);
-    tos = *sp--;
+    out.print((ucell_t) tos, task.m_base);
+    POP();
+    DRAIN();
   NEXT();
 
   // . ( n -- )
   // Display n in free field format.
   OP(DOT)
-#if 0
-    ios.print(tos, task.m_base);
-    ios.print(' ');
-    tos = *sp--;
+#if (FVM_CPP_DOT == 1)
+    if (task.m_base == 10)
+      out.print(tos);
+    else
+      out.print((ucell_t) tos, task.m_base);
+    out.print(' ');
+    POP();
+    DRAIN();
   NEXT();
 #else
   // : . ( n -- )
   // base @ 10 = if dup 0< if '-' emit negate then then u. space ;
   static const code_t DOT_CODE[] PROGMEM = {
-    FVM_OP(BASE),
+    FVM_SYSCALL(BASE),
     FVM_OP(FETCH),
-    FVM_CLIT(10),
-    FVM_OP(EQUALS),
+    FVM_OP(CLIT_EQUALS), 10,
     FVM_OP(ZERO_BRANCH), 9,
       FVM_OP(DUP),
       FVM_OP(ZERO_LESS),
@@ -1654,21 +3221,8 @@ DISPATCH:
   // .s ( -- )
   // Display stack contents.
   OP(DOT_S)
-#if 0
-    tmp = (sp - task.m_sp0);
-    ios.print('[');
-    ios.print(tmp);
-    ios.print(F("]: "));
-    if (tmp > 0) {
-      cell_t* tp = task.m_sp0 + 1;
-      while (--tmp) {
-	ios.print(*++tp, task.m_base);
-	ios.print(' ');
-      }
-      ios.print(tos);
-    }
-    ios.println();
-  NEXT();
+#if (FVM_CPP_DOT_S == 1)
+    COLD();
 #else
   // : .s ( -- )
   // depth dup '[' emit u. ']' emit ':' emit space
@@ -1704,150 +3258,1695 @@ DISPATCH:
 #if defined(ARDUINO_ARCH_AVR)
     /* FLASH_TOP used to work round avr-g++ bug. */
 
-    if ((uint16_t)ip < FLASH_TOP)
-      ip += ios.print((const __FlashStringHelper*) ip) + 1;
-    else
-      ip += ios.print((const char*) ip - CODE_P_MAX) + 1;
+    if ((uint16_t)ip < FLASH_TOP)
+      ip += out.print((const __FlashStringHelper*) ip) + 1;
+    else
+      ip += out.print((const char*) ip - CODE_P_MAX) + 1;
+#else
+  ip += out.print((const __FlashStringHelper*) ip) + 1;
+#endif
+    DRAIN();
+  NEXT();
+
+  // type ( a-addr -- )
+  // Display data memory string.
+  OP(TYPE)
+    out.print((const char*) pointer(tos));
+    POP();
+    DRAIN();
+  NEXT();
+
+  // .name ( xt -- length | 0 )
+  // Display name of word (token from lookup) and return length.
+  OP(DOT_NAME)
+    COLD();
+
+  // ? ( a-addr -- ) @ . ;
+  // Display value of cell at a-addr.
+  OP(QUESTION)
+  static const code_t QUESTION_CODE[] PROGMEM = {
+    FVM_OP(FETCH),
+    FVM_OP(DOT),
+    FVM_OP(EXIT)
+  };
+  CALL(QUESTION_CODE);
+
+  // delay ( ms -- )
+  // Yield while waiting given number of milli-seconds. The wake time
+  // is set in the task for the scheduler.
+  OP(DELAY)
+    task.m_wake = millis() + tos;
+  // : delay ( ms -- )
+  //   millis >r
+  //   begin millis r@- over u< while yield repeat
+  //   r> 2drop ;
+  static const code_t DELAY_CODE[] PROGMEM = {
+    FVM_OP(MILLIS),
+    FVM_OP(TO_R),
+      FVM_OP(MILLIS),
+      FVM_OP(R_FETCH_MINUS),
+      FVM_OP(OVER),
+      FVM_OP(U_LESS),
+    FVM_OP(ZERO_BRANCH), 4,
+      FVM_OP(YIELD),
+    FVM_OP(BRANCH), -8,
+    FVM_OP(R_FROM),
+    FVM_OP(TWO_DROP),
+    FVM_OP(EXIT)
+  };
+  CALL(DELAY_CODE);
+
+  // micros ( -- us )
+  // Micro-seconds.
+  OP(MICROS)
+    PUSH();
+    tos = micros();
+  NEXT();
+
+  // millis ( -- ms )
+  // Milli-seconds.
+  OP(MILLIS)
+    PUSH();
+    tos = millis();
+  NEXT();
+
+  // pinmode ( mode pin -- )
+  // Set digital pin mode.
+  OP(PINMODE)
+    COLD();
+
+  // digitalread ( pin -- state )
+  // Read digital pin.
+  OP(DIGITALREAD)
+    tos = digitalRead(tos);
+  NEXT();
+
+  // digitalwrite ( state pin -- )
+  // Write digital pin.
+  OP(DIGITALWRITE)
+    digitalWrite(tos, NOS);
+    POP_NOS();
+    POP();
+  NEXT();
+
+  // digitaltoggle ( pin -- )
+  // Toggle digital pin.
+  OP(DIGITALTOGGLE)
+    digitalWrite(tos, !digitalRead(tos));
+    POP();
+  NEXT();
+
+  // analogread ( pin -- sample )
+  // Read analog pin.
+  OP(ANALOGREAD)
+    tos = analogRead(tos & 0xf);
+  NEXT();
+
+  // analogwrite ( n pin -- )
+  // Write pwm pin.
+  OP(ANALOGWRITE)
+    analogWrite(tos, NOS);
+    POP_NOS();
+    POP();
+  NEXT();
+
+#if (FVM_CACHE == 1)
+  // (cache) ( -- )
+  // Return from threaded code to pre-decoded code.
+  OP(CACHE)
+    xp = (xcode_t*) *rp--;
+  XNEXT();
+#endif
+
+  // profile ( -- )
+  // Print token dispatch count and sampled ticks per token, and
+  // number of samples per log2(ticks). Or print call graph.
+  OP(PROFILE)
+    COLD();
+
+  // fncall ( -- )
+  // Internal threaded code call.
+  FNCALL:
+    GRAPH_NEST((uint8_t) ir);
+#if (FVM_KERNEL_OPT == 1)
+    if (fetch_byte(ip)) *++rp = ip;
+#else
+    *++rp = ip;
+#endif
+    ip = tp;
+  NEXT();
+
+  // coldcall ( -- )
+  // Rarely used operation; executed out of line with the parameter
+  // stack in memory.
+  COLDCALL:
+    SPILL();
+    task.m_sp = sp;
+    cold((uint8_t) ir, task, out);
+    sp = task.m_sp;
+    FILL();
+    DRAIN();
+  NEXT();
+
+#if (FVM_CACHE == 1)
+  // Pre-decoded code handlers. Operands are decoded by translate();
+  // branch and call targets are pre-decoded code pointers. Return
+  // addresses on the return stack are pre-decoded code pointers. Calls
+  // to threaded code push XRET to return to threaded code. Calls from
+  // pre-decoded code to threaded code and kernel operations use
+  // CACHE_CODE to return.
+
+  // Return to threaded code. Switch to trace when enabled while
+  // pre-decoded code was active.
+  X_RET:
+    ip = *rp--;
+#if (FVM_TRACE != 0)
+    if (TRACED(task, rp)) goto TRACE_CHANGED;
+#endif
+  NEXT();
+
+  XOP(ZERO_EXIT)
+    tmp = tos;
+    POP();
+    if (tmp != 0) XNEXT();
+  FALLTHROUGH();
+
+  XOP(EXIT)
+    xp = (xcode_t*) *rp--;
+  XNEXT();
+
+  XOP(LIT)
+    PUSH();
+    tos = (xp++)->value;
+  XNEXT();
+
+  XOP(PARAM)
+    tmp = (xp++)->value;
+    SPILL();
+    tos = *(sp - tmp);
+    FILL_NOS();
+  XNEXT();
+
+  XOP(BRANCH)
+    tp = (code_P) xp;
+    xp = xp->xp;
+    XFUEL(xp < (xcode_t*) tp);
+  XNEXT();
+
+  XOP(ZERO_BRANCH)
+    tp = (code_P) xp;
+    if (tos == 0) xp = xp->xp; else xp += 1;
+    POP();
+    XFUEL(xp < (xcode_t*) tp);
+  XNEXT();
+
+  XOP(DO)
+    tmp = NOS;
+    POP_NOS();
+    if (tos < tmp) {
+      LOOP_ENTER(tos, tmp);
+      xp += 1;
+    }
+    else {
+      xp = xp->xp;
+    }
+    POP();
+  XNEXT();
+
+  XOP(I)
+    PUSH();
+    tos = LOOP_INDEX();
+  XNEXT();
+
+  XOP(J)
+    PUSH();
+    tos = RCELL(*(rp - 2));
+  XNEXT();
+
+  XOP(LEAVE)
+    LOOP_FILL();
+    li = ll;
+    LOOP_STORE();
+  XNEXT();
+
+  XOP(LOOP)
+    LOOP_FILL();
+    li += 1;
+    if ((ucell_t) li < (ucell_t) ll) {
+      LOOP_STORE();
+      xp = xp->xp;
+      XFUEL(true);
+    }
+    else {
+      LOOP_EXIT();
+      xp += 1;
+    }
+  XNEXT();
+
+  XOP(PLUS_LOOP)
+    LOOP_FILL();
+    li += tos;
+    POP();
+    if ((ucell_t) li < (ucell_t) ll) {
+      LOOP_STORE();
+      xp = xp->xp;
+      XFUEL(true);
+    }
+    else {
+      LOOP_EXIT();
+      xp += 1;
+    }
+  XNEXT();
+
+  XOP(FOR)
+    if (tos > 0) {
+      LOOP_ENTER(tos - 1, 0);
+      xp += 1;
+    }
+    else {
+      xp = xp->xp;
+    }
+    POP();
+  XNEXT();
+
+  XOP(NEXT)
+    LOOP_FILL();
+    if (--li >= 0) {
+      LOOP_STORE();
+      xp = xp->xp;
+      XFUEL(true);
+    }
+    else {
+      LOOP_EXIT();
+      xp += 1;
+    }
+  XNEXT();
+
+  // Call pre-decoded code.
+  XOP(CALL)
+    *++rp = (code_P) (xp + 1);
+    xp = xp->xp;
+    XFUEL(true);
+  XNEXT();
+
+  // Call threaded code; return through CACHE_CODE.
+  XOP(BCALL)
+    *++rp = (code_P) (xp + 1);
+    *++rp = CACHE_CODE + 1;
+    ip = xp->ip;
+    FUEL(true);
+  NEXT();
+
+  // Execute kernel operation; continue with CACHE_CODE.
+  XOP(KERNEL)
+    *++rp = (code_P) (xp + 1);
+    ip = CACHE_CODE + 1;
+    ir = xp->value;
+  goto DISPATCH;
+
+  XOP(TO_R)
+    *++rp = RCODE(tos);
+    POP();
+  XNEXT();
+
+  XOP(R_FROM)
+    PUSH();
+    LOOP_POP();
+    tos = RCELL(*rp--);
+  XNEXT();
+
+  XOP(DROP)
+    POP();
+  XNEXT();
+
+  XOP(NIP)
+    POP_NOS();
+  XNEXT();
+
+  XOP(DUP)
+    PUSH();
+  XNEXT();
+
+  XOP(OVER)
+    tmp = NOS;
+    PUSH();
+    tos = tmp;
+  XNEXT();
+
+  XOP(SWAP)
+    tmp = tos;
+    tos = NOS;
+    NOS = tmp;
+  XNEXT();
+
+  XOP(ROT)
+    tmp = tos;
+    tos = THIRD;
+    THIRD = NOS;
+    NOS = tmp;
+  XNEXT();
+
+  XOP(C_FETCH)
+    tos = *((uint8_t*) pointer(tos));
+  XNEXT();
+
+  XOP(C_STORE)
+    *((uint8_t*) pointer(tos)) = NOS;
+    POP_NOS();
+    POP();
+  XNEXT();
+
+  XOP(FETCH)
+    tos = *((cell_t*) pointer(tos));
+  XNEXT();
+
+  XOP(STORE)
+    *((cell_t*) pointer(tos)) = NOS;
+    POP_NOS();
+    POP();
+  XNEXT();
+
+  XOP(INVERT)
+    tos = ~tos;
+  XNEXT();
+
+  XOP(AND)
+    tos = NOS & tos;
+    POP_NOS();
+  XNEXT();
+
+  XOP(OR)
+    tos = NOS | tos;
+    POP_NOS();
+  XNEXT();
+
+  XOP(XOR)
+    tos = NOS ^ tos;
+    POP_NOS();
+  XNEXT();
+
+  XOP(NEGATE)
+    tos = -tos;
+  XNEXT();
+
+  XOP(ONE_PLUS)
+    tos += 1;
+  XNEXT();
+
+  XOP(ONE_MINUS)
+    tos -= 1;
+  XNEXT();
+
+  XOP(TWO_STAR)
+    tos <<= 1;
+  XNEXT();
+
+  XOP(TWO_SLASH)
+    tos >>= 1;
+  XNEXT();
+
+  XOP(PLUS)
+    tos = NOS + tos;
+    POP_NOS();
+  XNEXT();
+
+  XOP(MINUS)
+    tos = NOS - tos;
+    POP_NOS();
+  XNEXT();
+
+  XOP(STAR)
+    tos = NOS * tos;
+    POP_NOS();
+  XNEXT();
+
+  XOP(ZERO_LESS)
+    tos = (tos < 0) ? -1 : 0;
+  XNEXT();
+
+  XOP(ZERO_EQUALS)
+    tos = (tos == 0) ? -1 : 0;
+  XNEXT();
+
+  XOP(NOT_EQUALS)
+    tos = (NOS != tos) ? -1 : 0;
+    POP_NOS();
+  XNEXT();
+
+  XOP(LESS)
+    tos = (NOS < tos) ? -1 : 0;
+    POP_NOS();
+  XNEXT();
+
+  XOP(EQUALS)
+    tos = (NOS == tos) ? -1 : 0;
+    POP_NOS();
+  XNEXT();
+
+  XOP(GREATER)
+    tos = (NOS > tos) ? -1 : 0;
+    POP_NOS();
+  XNEXT();
+
+  XOP(U_LESS)
+    tos = ((ucell_t) NOS < (ucell_t) tos) ? -1 : 0;
+    POP_NOS();
+  XNEXT();
+
+  XOP(DUP_ZERO_BRANCH)
+    tp = (code_P) xp;
+    if (tos == 0) xp = xp->xp; else xp += 1;
+    XFUEL(xp < (xcode_t*) tp);
+  XNEXT();
+
+  XOP(OVER_PLUS)
+    tos += NOS;
+  XNEXT();
+
+  XOP(OVER_MINUS)
+    tos -= NOS;
+  XNEXT();
+
+  XOP(R_FETCH_PLUS)
+    tos += LOOP_INDEX();
+  XNEXT();
+
+  XOP(R_FETCH_MINUS)
+    tos -= LOOP_INDEX();
+  XNEXT();
+
+  XOP(I_FETCH)
+    PUSH();
+    tos = *((cell_t*) pointer(LOOP_INDEX()));
+  XNEXT();
+
+  XOP(LIT_PLUS)
+    tos += (xp++)->value;
+  XNEXT();
+
+  XOP(LIT_EQUALS)
+    tos = (tos == (xp++)->value) ? -1 : 0;
+  XNEXT();
+
+#if (FVM_JIT == 1)
+  // Execute native code; continue with returned pre-decoded code.
+  XOP(NATIVE)
+    LOOP_SPILL();
+    SPILL_NOS();
+    {
+      jit_regs_t regs = { sp, rp, tos };
+      xp = ((jit_enter_t) m_jit)(&regs, xp->op);
+      sp = regs.sp;
+      rp = regs.rp;
+      tos = regs.tos;
+    }
+    FILL_NOS();
+  XNEXT();
+#endif
+#endif
+
+  default:
+    ;
+  }
+  return (-1);
+}
+
+void FVM::cold(uint8_t op, task_t& task, Print& out)
+{
+  cell_t* sp = task.m_sp;
+
+  switch (op) {
+
+  // room ( -- n bytes )
+  case OP_ROOM:
+    *++sp = WORD_MAX - m_next;
+#if (FVM_CACHE == 1)
+    *++sp = (uint8_t*) m_xdp - m_dp;
+#else
+    *++sp = m_line - m_dp;
+#endif
+    break;
+
+  // lookup ( str -- n )
+  case OP_LOOKUP:
+    *sp = lookup((const char*) pointer(*sp));
+    break;
+
+#if (FVM_CPP_WORDS == 1)
+  // words ( -- )
+  case OP_WORDS:
+  {
+    const char* s;
+    int len;
+    int nr = 0;
+    for (int i = 0; (s = (const char*) OPSTR(i)) != 0; i++) {
+      len = out.print((const __FlashStringHelper*) s);
+      if (++nr % 5 == 0)
+	out.println();
+      else {
+	for (;len < 16; len++) out.print(' ');
+      }
+    }
+    for (int i = 0; (s = (const char*) FNSTR(i)) != 0; i++) {
+      len = out.print((const __FlashStringHelper*) s);
+      if (++nr % 5 == 0)
+	out.println();
+      else {
+	for (;len < 16; len++) out.print(' ');
+      }
+    }
+  }
+  break;
+#endif
+
+#if (FVM_CPP_DOT_S == 1)
+  // .s ( -- )
+  case OP_DOT_S:
+  {
+    cell_t n = (sp - task.m_sp0) - 1;
+    out.print('[');
+    out.print(n, task.m_base);
+    out.print(F("]: "));
+    for (cell_t* tp = task.m_sp0 + 1; n--;) {
+      if (task.m_base == 10)
+	out.print(*++tp);
+      else
+	out.print((ucell_t) *++tp, task.m_base);
+      out.print(' ');
+    }
+    out.println();
+    task.m_out.drain();
+  }
+  break;
+#endif
+
+  // .name ( xt -- length | 0 )
+  case OP_DOT_NAME:
+  {
+    const __FlashStringHelper* s = NULL;
+    if (*sp < KERNEL_MAX)
+      s = (const __FlashStringHelper*) OPSTR(*sp);
+    else if (*sp < APPLICATION_MAX)
+      s = (const __FlashStringHelper*) FNSTR(*sp-KERNEL_MAX);
+    *sp = (s != NULL) ? out.print(s) : 0;
+  }
+  break;
+
+  // pinmode ( mode pin -- )
+  case OP_PINMODE:
+    pinMode(sp[0], sp[-1]);
+    sp -= 2;
+    break;
+
+  // profile ( -- )
+  case OP_PROFILE:
+    task.m_out.flush();
+#if (FVM_PROFILER == 1)
+  {
+    Stream& ios = task.m_ios;
+    profile();
+    for (int i = 0; i <= TOKEN_MAX; i++) {
+      if (s_profile.count[i] == 0) continue;
+      ios.print(i);
+      ios.print(':');
+      print_name(ios, i);
+      ios.print(':');
+      ios.print(s_profile.count[i]);
+      ios.print(':');
+      if (s_profile.samples[i] != 0)
+	ios.print((uint32_t) (s_profile.ticks[i] / s_profile.samples[i]));
+      ios.println();
+    }
+    for (int i = 0; i < 32; i++) {
+      if (s_profile.histogram[i] == 0) continue;
+      ios.print(F("ticks@"));
+      ios.print(1UL << i);
+      ios.print(':');
+      ios.println(s_profile.histogram[i]);
+    }
+  }
+#elif (FVM_PROFILER == 2)
+    print_graph(task.m_ios);
+#endif
+    break;
+  }
+  task.m_sp = sp;
+}
+
+#if (FVM_CACHE == 1)
+bool FVM::translate(uint8_t nr, const void* const* xtab)
+{
+  code_P body = (code_P) m_body[nr];
+  code_P end = (code_P) (nr + 1 < m_next ? m_name[nr + 1] : (char*) m_dp);
+  code_P ip;
+  xcode_t* xp;
+  int n = 0;
+  int res;
+
+  // Calls to the word are threaded code during translation
+  m_xcode[nr] = XCODE_NONE;
+
+  // Count number of elements and check all tokens. Called words
+  // are translated first
+  for (ip = body; ip < end; n += res)
+    if ((res = decode(ip, nr, 0, xtab)) < 0) return (false);
+  if (n == 0 || ip != end) return (false);
+
+  // Allocate from the end of the data area
+  xp = m_xdp - n;
+  if ((uint8_t*) xp < m_dp) return (false);
+  m_xdp = xp;
+  m_xcode[nr] = xp;
+
+  // Translate tokens; resolve branch and call targets
+  for (ip = body; ip < end; xp += res) {
+    if ((res = decode(ip, nr, xp, xtab)) < 0) {
+      m_xdp += n;
+      m_xcode[nr] = XCODE_NONE;
+      return (false);
+    }
+  }
+#if (FVM_JIT == 1)
+  jit(nr, n, xtab);
+#endif
+  return (true);
+}
+
+int FVM::decode(code_P& ip, uint8_t nr, xcode_t* xp, const void* const* xtab)
+{
+  code_P body = (code_P) m_body[nr];
+  code_P end = (code_P) (nr + 1 < m_next ? m_name[nr + 1] : (char*) m_dp);
+  int8_t ir = fetch_byte(ip++);
+  code_P tp;
+  cell_t tmp;
+  int op;
+  int xc;
+
+  // Application token; call threaded code in program memory
+  if (ir < 0) {
+    if (xp != 0) {
+      xp[0].op = xtab[XC_BCALL];
+      xp[1].ip = FNTAB(MAP(ir));
+    }
+    return (2);
+  }
+  op = ir;
+  if (op == OP_SYSCALL) op = (uint8_t) fetch_byte(ip++);
+
+  switch (op) {
+  case OP_LIT:
+    tmp = (uint8_t) fetch_byte(ip++);
+    tmp |= (fetch_byte(ip++) << 8);
+    goto LITERAL;
+  case OP_CLIT:
+    tmp = fetch_byte(ip++);
+    goto LITERAL;
+  case OP_WLIT:
+    tmp = fetch_word(ip);
+    ip += sizeof(cell_t);
+    goto LITERAL;
+  case OP_MINUS_TWO:
+    tmp = -2;
+    goto LITERAL;
+  case OP_MINUS_ONE:
+  case OP_TRUE:
+    tmp = -1;
+    goto LITERAL;
+  case OP_ZERO:
+  case OP_FALSE:
+    tmp = 0;
+    goto LITERAL;
+  case OP_ONE:
+    tmp = 1;
+    goto LITERAL;
+  case OP_TWO:
+    tmp = 2;
+    goto LITERAL;
+  case OP_CELL:
+    tmp = sizeof(cell_t);
+    goto LITERAL;
+  case OP_PARAM:
+    xc = XC_PARAM;
+    tmp = fetch_byte(ip++);
+    goto OPERAND;
+
+  // Branches; resolve offset to pre-decoded code pointer
+  case OP_BRANCH:
+    xc = XC_BRANCH;
+    goto BRANCH;
+  case OP_ZERO_BRANCH:
+    xc = XC_ZERO_BRANCH;
+    goto BRANCH;
+  case OP_DO:
+    xc = XC_DO;
+    goto BRANCH;
+  case OP_LOOP:
+    xc = XC_LOOP;
+    goto BRANCH;
+  case OP_PLUS_LOOP:
+    xc = XC_PLUS_LOOP;
+    goto BRANCH;
+  case OP_FOR:
+    xc = XC_FOR;
+    goto BRANCH;
+  case OP_NEXT:
+    xc = XC_NEXT;
+    goto BRANCH;
+  case OP_DUP_ZERO_BRANCH:
+    xc = XC_DUP_ZERO_BRANCH;
+    goto BRANCH;
+
+  // Superinstructions with inline literal
+  case OP_CLIT_PLUS:
+    xc = XC_LIT_PLUS;
+    tmp = fetch_byte(ip++);
+    goto OPERAND;
+  case OP_CLIT_EQUALS:
+    xc = XC_LIT_EQUALS;
+    tmp = fetch_byte(ip++);
+    goto OPERAND;
+
+  // Dynamic dictionary call; variables and constants are literals,
+  // translated words are called directly (or jumped to when followed
+  // by exit), others are threaded code calls
+  case OP_CALL:
+    op = (uint8_t) fetch_byte(ip++);
+    if (op >= m_next) return (-1);
+    tp = (code_P) m_body[op];
+    if (op != nr) {
+      if (fetch_byte(tp) == OP_VAR) {
+	tmp = address(tp + 1);
+	goto LITERAL;
+      }
+      if (fetch_byte(tp) == OP_CONST) {
+	tmp = fetch_word(tp + 1);
+	goto LITERAL;
+      }
+      if (m_xcode[op] == 0) translate(op, xtab);
+    }
+    if (xp != 0) {
+      if (m_xcode[op] == XCODE_NONE) {
+	xp[0].op = xtab[XC_BCALL];
+	xp[1].ip = tp;
+      }
+      else {
+	xc = (ip < end && fetch_byte(ip) == OP_EXIT) ? XC_BRANCH : XC_CALL;
+	xp[0].op = xtab[xc];
+	xp[1].xp = m_xcode[op];
+      }
+    }
+    return (2);
+
+  // Inline data, data structures and pre-decoded code return are
+  // not translated. Words that set trace mode stay threaded code so
+  // that the trace takes effect in the word
+  case OP_SLIT:
+  case OP_VAR:
+  case OP_CONST:
+  case OP_FUNC:
+  case OP_DOES:
+  case OP_COMPILE:
+  case OP_DOT_QUOTE:
+  case OP_CACHE:
+  case OP_TRACE:
+    return (-1);
+
+  // No operation is removed
+  case OP_NOOP:
+    return (0);
+
+  // Operations with pre-decoded code handler
+  case OP_EXIT: xc = XC_EXIT; break;
+  case OP_ZERO_EXIT: xc = XC_ZERO_EXIT; break;
+  case OP_I: xc = XC_I; break;
+  case OP_J: xc = XC_J; break;
+  case OP_LEAVE: xc = XC_LEAVE; break;
+  case OP_TO_R: xc = XC_TO_R; break;
+  case OP_R_FROM: xc = XC_R_FROM; break;
+  case OP_R_FETCH: xc = XC_I; break;
+  case OP_DROP: xc = XC_DROP; break;
+  case OP_NIP: xc = XC_NIP; break;
+  case OP_DUP: xc = XC_DUP; break;
+  case OP_OVER: xc = XC_OVER; break;
+  case OP_SWAP: xc = XC_SWAP; break;
+  case OP_ROT: xc = XC_ROT; break;
+  case OP_C_FETCH: xc = XC_C_FETCH; break;
+  case OP_C_STORE: xc = XC_C_STORE; break;
+  case OP_FETCH: xc = XC_FETCH; break;
+  case OP_STORE: xc = XC_STORE; break;
+  case OP_INVERT: xc = XC_INVERT; break;
+  case OP_AND: xc = XC_AND; break;
+  case OP_OR: xc = XC_OR; break;
+  case OP_XOR: xc = XC_XOR; break;
+  case OP_NEGATE: xc = XC_NEGATE; break;
+  case OP_ONE_PLUS: xc = XC_ONE_PLUS; break;
+  case OP_ONE_MINUS: xc = XC_ONE_MINUS; break;
+  case OP_TWO_STAR: xc = XC_TWO_STAR; break;
+  case OP_TWO_SLASH: xc = XC_TWO_SLASH; break;
+  case OP_PLUS: xc = XC_PLUS; break;
+  case OP_MINUS: xc = XC_MINUS; break;
+  case OP_STAR: xc = XC_STAR; break;
+  case OP_ZERO_LESS: xc = XC_ZERO_LESS; break;
+  case OP_NOT:
+  case OP_ZERO_EQUALS: xc = XC_ZERO_EQUALS; break;
+  case OP_NOT_EQUALS: xc = XC_NOT_EQUALS; break;
+  case OP_LESS: xc = XC_LESS; break;
+  case OP_EQUALS: xc = XC_EQUALS; break;
+  case OP_GREATER: xc = XC_GREATER; break;
+  case OP_U_LESS: xc = XC_U_LESS; break;
+  case OP_OVER_PLUS: xc = XC_OVER_PLUS; break;
+  case OP_OVER_MINUS: xc = XC_OVER_MINUS; break;
+  case OP_R_FETCH_PLUS: xc = XC_R_FETCH_PLUS; break;
+  case OP_R_FETCH_MINUS: xc = XC_R_FETCH_MINUS; break;
+  case OP_I_FETCH: xc = XC_I_FETCH; break;
+
+  // Other kernel operations are executed by the inner interpreter
+  default:
+    xc = XC_KERNEL;
+    tmp = op;
+    goto OPERAND;
+  }
+  if (xp != 0) xp[0].op = xtab[xc];
+  return (1);
+
+ BRANCH:
+  if (ir == OP_SYSCALL) {
+    tp = ip + fetch_offset(ip);
+    ip += 2;
+  }
+  else {
+    tp = ip + fetch_byte(ip);
+    ip += 1;
+  }
+  if (xp != 0) {
+    code_P np = body;
+    int ix = 0;
+    int res;
+    if (tp < body || tp >= end) return (-1);
+    while (np < tp) {
+      if ((res = decode(np, nr, 0, xtab)) < 0) return (-1);
+      ix += res;
+    }
+    if (np != tp) return (-1);
+    xp[0].op = xtab[xc];
+    xp[1].xp = m_xcode[nr] + ix;
+  }
+  return (2);
+
+ LITERAL:
+  xc = XC_LIT;
+ OPERAND:
+  if (xp != 0) {
+    xp[0].op = xtab[xc];
+    xp[1].value = tmp;
+  }
+  return (2);
+}
+#endif
+
+#if (FVM_JIT == 1)
+// Native code buffer size (bytes)
+static const size_t JIT_MAX = 0x10000;
+
+// Native code; x86-64 instruction sequences. Register usage; rbx
+// parameter stack pointer, r12d top of stack, r13 return stack
+// pointer, r15 register save area, rax, rcx scratch
+#define JIT_ENTER							\
+  "\x53\x41\x54\x41\x55\x41\x57"	/* push rbx, r12, r13, r15 */	\
+  "\x49\x89\xFF"			/* mov r15,rdi */		\
+  "\x49\x8B\x1F"			/* mov rbx,[r15] */		\
+  "\x4D\x8B\x6F\x08"			/* mov r13,[r15+8] */		\
+  "\x45\x8B\x67\x10"			/* mov r12d,[r15+16] */		\
+  "\xFF\xE6"				/* jmp rsi */
+#define JIT_LEAVE							\
+  "\x49\x89\x1F"			/* mov [r15],rbx */		\
+  "\x4D\x89\x6F\x08"			/* mov [r15+8],r13 */		\
+  "\x45\x89\x67\x10"			/* mov [r15+16],r12d */		\
+  "\x41\x5F\x41\x5D\x41\x5C\x5B"	/* pop r15, r13, r12, rbx */	\
+  "\xC3"				/* ret */
+#define JIT_PUSH "\x48\x83\xC3\x04\x44\x89\x23"
+#define JIT_POP "\x44\x8B\x23\x48\x83\xEB\x04"
+#define JIT_NIP "\x48\x83\xEB\x04"
+#define JIT_POP2 "\x44\x8B\x63\xFC\x48\x83\xEB\x08"
+#define JIT_NOS_TO_ECX "\x8B\x0B"
+#define JIT_EAX_TO_TOS "\x41\x89\xC4"
+#define JIT_TOS_TO_EAX "\x44\x89\xE0"
+#define JIT_TOS_TO_RAX "\x49\x63\xC4"
+#define JIT_RP_TO_RAX "\x49\x8B\x45\x00"
+#define JIT_RAX_TO_RP "\x49\x89\x45\x00"
+#define JIT_RPUSH "\x49\x83\xC5\x08"
+#define JIT_RDROP "\x49\x83\xED\x08"
+#define JIT_FLAG "\xF7\xD8\x41\x89\xC4"
+#define JIT_COMPARE(cc)							\
+  JIT_NOS_TO_ECX JIT_NIP "\x31\xC0\x44\x39\xE1\x0F" cc "\xC0" JIT_FLAG
+#define JIT_EXIT JIT_RP_TO_RAX JIT_RDROP
+#define JIT_MOV_RAX "\x48\xB8"
+#define JIT_JMP "\xE9"
+#define JIT_JZ "\x0F\x84"
+#define JIT_JNZ "\x0F\x85"
+#define JIT_JL "\x0F\x8C"
+#define JIT_JGE "\x0F\x8D"
+#define JIT_JB "\x0F\x82"
+
+#define JIT_EMIT(s) (memcpy(jp, s, sizeof(s) - 1), jp += sizeof(s) - 1)
+#define JIT_IMM32(v) (*((int32_t*) jp) = (v), jp += 4)
+#define JIT_IMM64(v) (*((uint64_t*) jp) = (uint64_t) (v), jp += 8)
+#define JIT_REL32(tp) JIT_IMM32((tp) - (jp + 4))
+
+// Translate cell address in rax to pointer; add origin (FVM_OFFSET)
+#if (FVM_OFFSET == 1)
+#define JIT_ORIGIN()							\
+  (JIT_EMIT("\x48\xB9"), JIT_IMM64(FVM::s_origin), JIT_EMIT("\x48\x01\xC8"))
+#else
+#define JIT_ORIGIN() ((void) 0)
+#endif
+
+// Native code generation state; word pre-decoded code and number of
+// elements, handler address table, word native code (or null when
+// counting), and call-out stubs
+struct jit_t {
+  FVM::xcode_t* base;
+  int n;
+  const void* const* xtab;
+  uint8_t* start;
+  uint8_t* leave;
+  FVM::xcode_t* stub;
+  int stubs;
+};
+
+// Map handler address to pre-decoded code handler index
+static int jit_xc(const jit_t& jit, const void* op)
+{
+  for (int xc = 0; xc < XC_MAX; xc++)
+    if (jit.xtab[xc] == op) return (xc);
+  return (-1);
+}
+
+// Number of pre-decoded code elements for given handler
+static int jit_length(int xc)
+{
+  switch (xc) {
+  case XC_LIT:
+  case XC_PARAM:
+  case XC_BRANCH:
+  case XC_ZERO_BRANCH:
+  case XC_DO:
+  case XC_LOOP:
+  case XC_PLUS_LOOP:
+  case XC_FOR:
+  case XC_NEXT:
+  case XC_CALL:
+  case XC_BCALL:
+  case XC_KERNEL:
+  case XC_DUP_ZERO_BRANCH:
+  case XC_LIT_PLUS:
+  case XC_LIT_EQUALS:
+    return (2);
+  }
+  return (1);
+}
+
+static int jit_emit(jit_t& jit, int ix, uint8_t* dp);
+
+// Native code address of given pre-decoded code element
+static uint8_t* jit_label(jit_t& jit, int ix)
+{
+  uint8_t* tp = jit.start;
+  for (int i = 0; i < ix; i += jit_length(jit_xc(jit, jit.base[i].op)))
+    tp += jit_emit(jit, i, 0);
+  return (tp);
+}
+
+// Native code address of given branch target; must be in word
+static uint8_t* jit_target(jit_t& jit, FVM::xcode_t* xp)
+{
+  return (jit_label(jit, xp - jit.base));
+}
+
+// Emit native code for pre-decoded code element. Count only when
+// given code pointer is null. Return length of code or negative
+// error code(-1) if the element may not be compiled
+static int jit_emit(jit_t& jit, int ix, uint8_t* dp)
+{
+  FVM::xcode_t* xp = jit.base + ix;
+  int xc = jit_xc(jit, xp->op);
+  bool write = (dp != 0);
+  uint8_t buf[64];
+  uint8_t* jp = write ? dp : buf;
+  FVM::xcode_t* tp = 0;
+
+  // Branch targets must be within the word; a branch to another
+  // word is a tail call
+  if (xc == XC_BRANCH || xc == XC_ZERO_BRANCH || xc == XC_DO
+      || xc == XC_LOOP || xc == XC_PLUS_LOOP || xc == XC_FOR
+      || xc == XC_NEXT || xc == XC_DUP_ZERO_BRANCH) {
+    tp = xp[1].xp;
+    if ((tp < jit.base || tp >= jit.base + jit.n) && xc != XC_BRANCH)
+      return (-1);
+  }
+
+  switch (xc) {
+  case XC_EXIT:
+    JIT_EMIT(JIT_EXIT JIT_JMP);
+    JIT_REL32(jit.leave);
+    break;
+  case XC_ZERO_EXIT:
+    JIT_EMIT(JIT_TOS_TO_EAX JIT_POP "\x85\xC0\x75\x0D" JIT_EXIT JIT_JMP);
+    JIT_REL32(jit.leave);
+    break;
+  case XC_LIT:
+    JIT_EMIT(JIT_PUSH "\x41\xBC");
+    JIT_IMM32(xp[1].value);
+    break;
+  case XC_PARAM:
+    JIT_EMIT(JIT_PUSH "\x44\x8B\xA3");
+    JIT_IMM32(-xp[1].value * (int) sizeof(FVM::cell_t));
+    break;
+  case XC_BRANCH:
+    if (tp < jit.base || tp >= jit.base + jit.n) {
+      JIT_EMIT(JIT_MOV_RAX);
+      JIT_IMM64(tp);
+      JIT_EMIT(JIT_JMP);
+      JIT_REL32(jit.leave);
+    }
+    else {
+      JIT_EMIT(JIT_JMP);
+      JIT_REL32(write ? jit_target(jit, tp) : jp);
+    }
+    break;
+  case XC_ZERO_BRANCH:
+    JIT_EMIT(JIT_TOS_TO_EAX JIT_POP "\x85\xC0" JIT_JZ);
+    JIT_REL32(write ? jit_target(jit, tp) : jp);
+    break;
+  case XC_DUP_ZERO_BRANCH:
+    JIT_EMIT("\x45\x85\xE4" JIT_JZ);
+    JIT_REL32(write ? jit_target(jit, tp) : jp);
+    break;
+  case XC_DO:
+    JIT_EMIT("\x8B\x03" JIT_NIP "\x44\x89\xE1" JIT_POP "\x39\xC1" JIT_JGE);
+    JIT_REL32(write ? jit_target(jit, tp) : jp);
+    JIT_EMIT("\x48\x63\xC0" JIT_RPUSH JIT_RAX_TO_RP
+	     "\x48\x63\xC9" JIT_RPUSH "\x49\x89\x4D\x00");
+    break;
+  case XC_LOOP:
+    JIT_EMIT(JIT_RP_TO_RAX "\x48\x83\xC0\x01" JIT_RAX_TO_RP
+	     "\x49\x3B\x45\xF8" JIT_JB);
+    JIT_REL32(write ? jit_target(jit, tp) : jp);
+    JIT_EMIT("\x49\x83\xED\x10");
+    break;
+  case XC_PLUS_LOOP:
+    JIT_EMIT("\x49\x63\xCC" JIT_RP_TO_RAX "\x48\x01\xC8" JIT_RAX_TO_RP
+	     JIT_POP "\x49\x3B\x45\xF8" JIT_JB);
+    JIT_REL32(write ? jit_target(jit, tp) : jp);
+    JIT_EMIT("\x49\x83\xED\x10");
+    break;
+  case XC_FOR:
+    JIT_EMIT("\x44\x89\xE1" JIT_POP "\x83\xE9\x01" JIT_JL);
+    JIT_REL32(write ? jit_target(jit, tp) : jp);
+    JIT_EMIT(JIT_RPUSH "\x49\xC7\x45\x00\x00\x00\x00\x00"
+	     "\x48\x63\xC9" JIT_RPUSH "\x49\x89\x4D\x00");
+    break;
+  case XC_NEXT:
+    JIT_EMIT("\x49\x83\x6D\x00\x01" JIT_JGE);
+    JIT_REL32(write ? jit_target(jit, tp) : jp);
+    JIT_EMIT("\x49\x83\xED\x10");
+    break;
+  case XC_I:
+    JIT_EMIT(JIT_PUSH "\x45\x8B\x65\x00");
+    break;
+  case XC_J:
+    JIT_EMIT(JIT_PUSH "\x45\x8B\x65\xF0");
+    break;
+  case XC_LEAVE:
+    JIT_EMIT("\x49\x8B\x45\xF8" JIT_RAX_TO_RP);
+    break;
+  case XC_TO_R:
+    JIT_EMIT(JIT_TOS_TO_RAX JIT_RPUSH JIT_RAX_TO_RP JIT_POP);
+    break;
+  case XC_R_FROM:
+    JIT_EMIT(JIT_PUSH "\x45\x8B\x65\x00" JIT_RDROP);
+    break;
+  case XC_DROP:
+    JIT_EMIT(JIT_POP);
+    break;
+  case XC_NIP:
+    JIT_EMIT(JIT_NIP);
+    break;
+  case XC_DUP:
+    JIT_EMIT(JIT_PUSH);
+    break;
+  case XC_OVER:
+    JIT_EMIT("\x8B\x03" JIT_PUSH JIT_EAX_TO_TOS);
+    break;
+  case XC_SWAP:
+    JIT_EMIT("\x8B\x03\x44\x89\x23" JIT_EAX_TO_TOS);
+    break;
+  case XC_ROT:
+    JIT_EMIT("\x8B\x43\xFC\x8B\x0B\x89\x4B\xFC\x44\x89\x23" JIT_EAX_TO_TOS);
+    break;
+  case XC_C_FETCH:
+    JIT_EMIT(JIT_TOS_TO_RAX);
+    JIT_ORIGIN();
+    JIT_EMIT("\x44\x0F\xB6\x20");
+    break;
+  case XC_C_STORE:
+    JIT_EMIT(JIT_TOS_TO_RAX);
+    JIT_ORIGIN();
+    JIT_EMIT(JIT_NOS_TO_ECX "\x88\x08" JIT_POP2);
+    break;
+  case XC_FETCH:
+    JIT_EMIT(JIT_TOS_TO_RAX);
+    JIT_ORIGIN();
+    JIT_EMIT("\x44\x8B\x20");
+    break;
+  case XC_STORE:
+    JIT_EMIT(JIT_TOS_TO_RAX);
+    JIT_ORIGIN();
+    JIT_EMIT(JIT_NOS_TO_ECX "\x89\x08" JIT_POP2);
+    break;
+  case XC_INVERT:
+    JIT_EMIT("\x41\xF7\xD4");
+    break;
+  case XC_AND:
+    JIT_EMIT("\x44\x23\x23" JIT_NIP);
+    break;
+  case XC_OR:
+    JIT_EMIT("\x44\x0B\x23" JIT_NIP);
+    break;
+  case XC_XOR:
+    JIT_EMIT("\x44\x33\x23" JIT_NIP);
+    break;
+  case XC_NEGATE:
+    JIT_EMIT("\x41\xF7\xDC");
+    break;
+  case XC_ONE_PLUS:
+    JIT_EMIT("\x41\x83\xC4\x01");
+    break;
+  case XC_ONE_MINUS:
+    JIT_EMIT("\x41\x83\xEC\x01");
+    break;
+  case XC_TWO_STAR:
+    JIT_EMIT("\x41\xD1\xE4");
+    break;
+  case XC_TWO_SLASH:
+    JIT_EMIT("\x41\xD1\xFC");
+    break;
+  case XC_PLUS:
+    JIT_EMIT("\x44\x03\x23" JIT_NIP);
+    break;
+  case XC_MINUS:
+    JIT_EMIT("\x8B\x03\x44\x29\xE0" JIT_EAX_TO_TOS JIT_NIP);
+    break;
+  case XC_STAR:
+    JIT_EMIT("\x44\x0F\xAF\x23" JIT_NIP);
+    break;
+  case XC_ZERO_LESS:
+    JIT_EMIT("\x41\xC1\xFC\x1F");
+    break;
+  case XC_ZERO_EQUALS:
+    JIT_EMIT("\x31\xC0\x45\x85\xE4\x0F\x94\xC0" JIT_FLAG);
+    break;
+  case XC_NOT_EQUALS:
+    JIT_EMIT(JIT_COMPARE("\x95"));
+    break;
+  case XC_LESS:
+    JIT_EMIT(JIT_COMPARE("\x9C"));
+    break;
+  case XC_EQUALS:
+    JIT_EMIT(JIT_COMPARE("\x94"));
+    break;
+  case XC_GREATER:
+    JIT_EMIT(JIT_COMPARE("\x9F"));
+    break;
+  case XC_U_LESS:
+    JIT_EMIT(JIT_COMPARE("\x92"));
+    break;
+  case XC_OVER_PLUS:
+    JIT_EMIT("\x44\x03\x23");
+    break;
+  case XC_OVER_MINUS:
+    JIT_EMIT("\x44\x2B\x23");
+    break;
+  case XC_R_FETCH_PLUS:
+    JIT_EMIT("\x45\x03\x65\x00");
+    break;
+  case XC_R_FETCH_MINUS:
+    JIT_EMIT("\x45\x2B\x65\x00");
+    break;
+  case XC_I_FETCH:
+    JIT_EMIT(JIT_PUSH JIT_RP_TO_RAX);
+    JIT_ORIGIN();
+    JIT_EMIT("\x44\x8B\x20");
+    break;
+  case XC_LIT_PLUS:
+    JIT_EMIT("\x41\x81\xC4");
+    JIT_IMM32(xp[1].value);
+    break;
+  case XC_LIT_EQUALS:
+    JIT_EMIT("\x31\xC0\x41\x81\xFC");
+    JIT_IMM32(xp[1].value);
+    JIT_EMIT("\x0F\x94\xC0" JIT_FLAG);
+    break;
+
+  // Calls and kernel operations are executed by the inner
+  // interpreter; call-out stub with the element followed by native
+  // code continuation
+  case XC_CALL:
+  case XC_BCALL:
+  case XC_KERNEL:
+    if (write) {
+      tp = jit.stub;
+      jit.stub += 4;
+      tp[0] = xp[0];
+      tp[1] = xp[1];
+      tp[2].op = jit.xtab[XC_NATIVE];
+      tp[3].op = jit_label(jit, ix + 2);
+    }
+    else {
+      jit.stubs += 1;
+    }
+    JIT_EMIT(JIT_MOV_RAX);
+    JIT_IMM64(tp);
+    JIT_EMIT(JIT_JMP);
+    JIT_REL32(jit.leave);
+    break;
+  default:
+    return (-1);
+  }
+  return (jp - (write ? dp : buf));
+}
+
+bool FVM::jit(uint8_t nr, int n, const void* const* xtab)
+{
+  static const uint8_t ENTER[] = JIT_ENTER;
+  static const uint8_t LEAVE[] = JIT_LEAVE;
+  jit_t jit;
+  int length = 0;
+  int res;
+
+  // Allocate native code buffer with enter and leave code. The
+  // buffer is never writable and executable at the same time (W^X)
+  if (m_jit == 0) {
+    void* buf = mmap(0, JIT_MAX,
+		     PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS,
+		     -1, 0);
+    if (buf == MAP_FAILED) {
+      m_jit = (uint8_t*) MAP_FAILED;
+      return (false);
+    }
+    memcpy(buf, ENTER, sizeof(ENTER) - 1);
+    memcpy((uint8_t*) buf + sizeof(ENTER) - 1, LEAVE, sizeof(LEAVE) - 1);
+    if (mprotect(buf, JIT_MAX, PROT_READ | PROT_EXEC) != 0) {
+      munmap(buf, JIT_MAX);
+      m_jit = (uint8_t*) MAP_FAILED;
+      return (false);
+    }
+    m_jit = (uint8_t*) buf;
+    m_jp0 = m_jit + sizeof(ENTER) + sizeof(LEAVE) - 2;
+    m_jp = m_jp0;
+  }
+  if (m_jit == (uint8_t*) MAP_FAILED || n < 2) return (false);
+
+  // Count native code and call-out stubs. Check that all elements
+  // may be compiled
+  jit.base = m_xcode[nr];
+  jit.n = n;
+  jit.xtab = xtab;
+  jit.start = m_jp;
+  jit.leave = m_jit + sizeof(ENTER) - 1;
+  jit.stubs = 0;
+  for (int ix = 0; ix < n; ix += jit_length(jit_xc(jit, jit.base[ix].op))) {
+    if ((res = jit_emit(jit, ix, 0)) < 0) return (false);
+    length += res;
+  }
+  if (m_jp + length > m_jit + JIT_MAX) return (false);
+
+  // Allocate call-out stubs from the end of the data area
+  jit.stub = m_xdp - 4 * jit.stubs;
+  if ((uint8_t*) jit.stub < m_dp) return (false);
+
+  // Generate native code with the buffer writable; executable again
+  // before the word entry is changed to native code
+  if (mprotect(m_jit, JIT_MAX, PROT_READ | PROT_WRITE) != 0)
+    return (false);
+  m_xdp = jit.stub;
+  for (int ix = 0; ix < n; ix += jit_length(jit_xc(jit, jit.base[ix].op)))
+    m_jp += jit_emit(jit, ix, m_jp);
+  if (mprotect(m_jit, JIT_MAX, PROT_READ | PROT_EXEC) != 0)
+    return (false);
+  jit.base[0].op = xtab[XC_NATIVE];
+  jit.base[1].op = jit.start;
+  return (true);
+}
+#endif
+
+int FVM::execute(int op, task_t& task)
+{
+  if (op < 0 || op > TOKEN_MAX) return (-1);
+  static const code_t EXECUTE_CODE[] PROGMEM = {
+    FVM_OP(EXECUTE),
+    FVM_OP(HALT)
+  };
+  task.push(op);
+  return (execute(EXECUTE_CODE, task));
+}
+
+#if !defined(ARDUINO_ARCH_AVR)
+const FVM::profile_t* FVM::profile()
+{
+#if (FVM_PROFILER == 1)
+  return (&s_profile);
+#else
+  return (0);
+#endif
+}
+
+const FVM::graph_t* FVM::graph()
+{
+#if (FVM_PROFILER == 2)
+  for (int i = s_graph.nodes - 1; i >= 0; i--) {
+    graph_t::node_t* np = &s_graph.node[i];
+    np->inclusive = np->ticks;
+    for (int nr = np->child; nr != 0; nr = s_graph.node[nr].sibling)
+      np->inclusive += s_graph.node[nr].inclusive;
+  }
+  return (&s_graph);
+#else
+  return (0);
+#endif
+}
+
+void FVM::print_graph(Stream& ios)
+{
+#if (FVM_PROFILER == 2)
+  for (int i = 1; i < s_graph.nodes; i++) {
+    if (s_graph.node[i].ticks == 0) continue;
+    print_path(ios, i);
+    ios.print(' ');
+    ios.println((uint32_t) s_graph.node[i].ticks);
+  }
+#else
+  (void) ios;
+#endif
+}
+
+void FVM::profile_reset()
+{
+#if (FVM_PROFILER == 1)
+  memset(&s_profile, 0, sizeof(s_profile));
+  profile_stop();
+  s_countdown = PROFILE_PERIOD;
+#elif (FVM_PROFILER == 2)
+  memset(&s_graph, 0, sizeof(s_graph));
+  s_graph.nodes = 1;
+#endif
+}
+
+const FVM::trace_t* FVM::trace_buffer(uint32_t& count)
+{
+#if (FVM_TRACE == 3)
+  count = s_trace_count;
+  return (s_trace);
+#else
+  count = 0;
+  return (0);
+#endif
+}
+
+void FVM::print_trace(Stream& ios, const trace_t* buf, uint32_t count)
+{
+  uint32_t first = (count > TRACE_MAX) ? count - TRACE_MAX : 0;
+  for (uint32_t i = first; i < count; i++) {
+    const trace_t* tr = &buf[i & (TRACE_MAX - 1)];
+    uint32_t us = 0;
+    for (uint32_t j = i; j > first; j--) {
+      const trace_t* pr = &buf[(j - 1) & (TRACE_MAX - 1)];
+      if (pr->task != tr->task) continue;
+      us = tr->time - pr->time;
+      break;
+    }
+    ios.print(F("task@"));
+    ios.print((uintptr_t) tr->task);
+    ios.print(':');
+    ios.print(us);
+    ios.print(':');
+    ios.print((uintptr_t) tr->ip);
+    ios.print(':');
+    ios.print(tr->depth);
+    ios.print(':');
+    print_name(ios, tr->token);
+    ios.print(F(":["));
+    ios.print(tr->size);
+    ios.print(F("]: "));
+    if (tr->size > 0) ios.print(tr->tos);
+    ios.println();
+  }
+}
+
+void FVM::print_name(Stream& ios, int token)
+{
+  if (token < KERNEL_MAX) {
+#if (FVM_KERNEL_DICT == 0)
+    ios.print(token);
 #else
-  ip += ios.print((const __FlashStringHelper*) ip) + 1;
+    ios.print(OPSTR(token));
 #endif
-
-  NEXT();
-
-  // type ( a-addr -- )
-  // Display data memory string.
-  OP(TYPE)
-    ios.print((const char*) tos);
-    tos = *sp--;
-  NEXT();
-
-  // .name ( xt -- length | 0 )
-  // Display name of word (token from lookup) and return length.
-  OP(DOT_NAME)
-  {
-    const __FlashStringHelper* s = NULL;
-    if (tos < KERNEL_MAX)
-      s = (const __FlashStringHelper*) OPSTR(tos);
-    else if (tos < APPLICATION_MAX)
-      s = (const __FlashStringHelper*) FNSTR(tos-KERNEL_MAX);
-    tos = (s != NULL) ? ios.print(s) : 0;
   }
-  NEXT();
+  else if (token < APPLICATION_MAX)
+    ios.print(FNSTR(token - KERNEL_MAX));
+  else if (token - APPLICATION_MAX < m_next)
+    ios.print(m_name[token - APPLICATION_MAX]);
+}
 
-  // ? ( a-addr -- ) @ . ;
-  // Display value of cell at a-addr.
-  OP(QUESTION)
-  static const code_t QUESTION_CODE[] PROGMEM = {
-    FVM_OP(FETCH),
-    FVM_OP(DOT),
-    FVM_OP(EXIT)
-  };
-  CALL(QUESTION_CODE);
+void FVM::print_path(Stream& ios, int node)
+{
+#if (FVM_PROFILER == 2)
+  int parent = s_graph.node[node].parent;
+  if (parent != 0) {
+    print_path(ios, parent);
+    ios.print(';');
+  }
+  print_name(ios, s_graph.node[node].token);
+#else
+  (void) ios;
+  (void) node;
+#endif
+}
+#endif
 
-  // delay ( ms -- )
-  // Yield while waiting given number of milli-seconds.
-  OP(DELAY)
-  // : delay ( ms -- )
-  //   millis >r
-  //   begin millis r@ - over u< while yield repeat
-  //   r> 2drop ;
-  static const code_t DELAY_CODE[] PROGMEM = {
-    FVM_OP(MILLIS),
-    FVM_OP(TO_R),
-      FVM_OP(MILLIS),
-      FVM_OP(R_FETCH),
-      FVM_OP(MINUS),
-      FVM_OP(OVER),
-      FVM_OP(U_LESS),
-    FVM_OP(ZERO_BRANCH), 4,
-      FVM_OP(YIELD),
-    FVM_OP(BRANCH), -9,
-    FVM_OP(R_FROM),
-    FVM_OP(TWO_DROP),
-    FVM_OP(EXIT)
-  };
-  CALL(DELAY_CODE);
+bool FVM::Output::drain()
+{
+  if (m_count != 0) {
+    size_t n = m_ios.write(m_buf, m_count);
+    if (n >= m_count) {
+      m_count = 0;
+    }
+    else if (n > 0) {
+      m_count -= n;
+      memmove(m_buf, m_buf + n, m_count);
+    }
+  }
+  return (m_count <= (m_size >> 1));
+}
 
-  // micros ( -- us )
-  // Micro-seconds.
-  OP(MICROS)
-    *++sp = tos;
-    tos = micros();
-  NEXT();
+void FVM::Output::flush()
+{
+  while (m_count != 0) drain();
+}
 
-  // millis ( -- ms )
-  // Milli-seconds.
-  OP(MILLIS)
-    *++sp = tos;
-    tos = millis();
-  NEXT();
+size_t FVM::Output::write(uint8_t c)
+{
+  if (m_size == 0) return (m_ios.write(c));
+  while (m_count == m_size) drain();
+  m_buf[m_count++] = c;
+  return (1);
+}
 
-  // pinmode ( mode pin -- )
-  // Set digital pin mode.
-  OP(PINMODE)
-    pinMode(tos, *sp--);
-    tos = *sp--;
-  NEXT();
+size_t FVM::Output::write(const uint8_t* buf, size_t size)
+{
+  if (m_size == 0) return (m_ios.write(buf, size));
+  size_t res = size;
+  while (size != 0) {
+    while (m_count == m_size) drain();
+    size_t n = m_size - m_count;
+    if (n > size) n = size;
+    memcpy(m_buf + m_count, buf, n);
+    m_count += n;
+    buf += n;
+    size -= n;
+  }
+  return (res);
+}
 
-  // digitalread ( pin -- state )
-  // Read digital pin.
-  OP(DIGITALREAD)
-    tos = digitalRead(tos);
-  NEXT();
+FVM::Scheduler::Scheduler(FVM& fvm, uint32_t budget) :
+  m_fvm(fvm),
+  m_budget(budget),
+  m_ready(0),
+  m_last(0),
+  m_input(0),
+#if defined(__linux__)
+  m_epoll(-1),
+  m_fds(0),
+#endif
+  m_time(millis()),
+  m_tasks(0)
+{
+  for (int i = 0; i < WHEEL_MAX; i++) m_wheel[i] = 0;
+}
 
-  // digitalwrite ( state pin -- )
-  // Write digital pin.
-  OP(DIGITALWRITE)
-    digitalWrite(tos, *sp--);
-    tos = *sp--;
-  NEXT();
+void FVM::Scheduler::add(task_t& task)
+{
+  m_tasks += 1;
+  schedule(task);
+}
 
-  // digitaltoggle ( pin -- )
-  // Toggle digital pin.
-  OP(DIGITALTOGGLE)
-    digitalWrite(tos, !digitalRead(tos));
-    tos = *sp--;
-  NEXT();
+#if defined(__linux__)
+void FVM::Scheduler::add(task_t& task, int fd)
+{
+  if (m_epoll < 0) m_epoll = epoll_create1(0);
+  task.m_fd = fd;
+  add(task);
+}
+#endif
 
-  // analogread ( pin -- sample )
-  // Read analog pin.
-  OP(ANALOGREAD)
-    tos = analogRead(tos & 0xf);
-  NEXT();
+void FVM::Scheduler::park(task_t& task)
+{
+#if defined(__linux__)
+  // Wait for file descriptor input; the one-shot event is armed
+  // only while the task is parked
+  if (task.m_fd >= 0) {
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = &task;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_MOD, task.m_fd, &event) < 0)
+      epoll_ctl(m_epoll, EPOLL_CTL_ADD, task.m_fd, &event);
+    m_fds += 1;
+    return;
+  }
+#endif
+  task.m_link = m_input;
+  m_input = &task;
+}
 
-  // analogwrite ( n pin -- )
-  // Write pwm pin.
-  OP(ANALOGWRITE)
-    analogWrite(tos, *sp--);
-    tos = *sp--;
-  NEXT();
+void FVM::Scheduler::poll(uint32_t ms)
+{
+  // Move tasks with input stream data to the ready queue
+  task_t** tp = &m_input;
+  while (*tp != 0) {
+    task_t* task = *tp;
+    if (!task->m_ios.available()) {
+      tp = &task->m_link;
+      continue;
+    }
+    *tp = task->m_link;
+    schedule(*task);
+  }
 
-  // fncall ( -- )
-  // Internal threaded code call.
-  FNCALL:
-#if (FVM_KERNEL_OPT == 1)
-    if (fetch_byte(ip)) *++rp = ip;
+#if defined(__linux__)
+  // Wait for file descriptor input
+  if (m_fds == 0) return;
+  struct epoll_event event[32];
+  int n = epoll_wait(m_epoll, event, 32, ms);
+  for (int i = 0; i < n; i++) {
+    m_fds -= 1;
+    schedule(*(task_t*) event[i].data.ptr);
+  }
 #else
-    *++rp = ip;
+  (void) ms;
 #endif
-    ip = tp;
-  NEXT();
+}
 
-  default:
-    ;
+void FVM::Scheduler::schedule(task_t& task)
+{
+  task.m_link = 0;
+  if ((int32_t) (task.m_wake - millis()) > 0) {
+    task_t** slot = &m_wheel[task.m_wake & (WHEEL_MAX - 1)];
+    task.m_link = *slot;
+    *slot = &task;
+  }
+  else if (m_ready == 0) {
+    m_ready = m_last = &task;
+  }
+  else {
+    m_last->m_link = &task;
+    m_last = &task;
   }
-  return (-1);
 }
 
-int FVM::execute(int op, task_t& task)
+uint32_t FVM::Scheduler::timeout()
 {
-  if (op < 0 || op > TOKEN_MAX) return (-1);
-  static const code_t EXECUTE_CODE[] PROGMEM = {
-    FVM_OP(EXECUTE),
-    FVM_OP(HALT)
-  };
-  task.push(op);
-  return (execute(EXECUTE_CODE, task));
+  // Poll input streams every milli-second
+  if (m_input != 0) return (1);
+  uint32_t now = millis();
+  for (uint32_t i = 1; i <= WHEEL_MAX; i++) {
+    uint32_t time = m_time + i;
+    task_t* task = m_wheel[time & (WHEEL_MAX - 1)];
+    for (; task != 0; task = task->m_link) {
+      if (task->m_wake != time) continue;
+      return ((int32_t) (time - now) > 0 ? time - now : 0);
+    }
+  }
+  return (WHEEL_MAX);
+}
+
+int FVM::Scheduler::run()
+{
+  // Move tasks with passed wake time from the timer wheel slots
+  // since the latest run to the ready queue
+  uint32_t now = millis();
+  uint32_t n = now - m_time;
+  if (n > WHEEL_MAX) n = WHEEL_MAX;
+  for (uint32_t i = 0; i < n; i++) {
+    task_t** tp = &m_wheel[(now - i) & (WHEEL_MAX - 1)];
+    while (*tp != 0) {
+      task_t* task = *tp;
+      if ((int32_t) (task->m_wake - now) > 0) {
+	tp = &task->m_link;
+	continue;
+      }
+      *tp = task->m_link;
+      schedule(*task);
+    }
+  }
+  m_time = now;
+  poll();
+
+  // Resume ready tasks. Yielding and preempted tasks are scheduled
+  // again or parked when waiting for input
+  task_t* task = m_ready;
+  m_ready = m_last = 0;
+  int res = 0;
+  while (task != 0) {
+    task_t* next = task->m_link;
+    if (m_fvm.resume(*task, m_budget) <= 0)
+      m_tasks -= 1;
+    else if (task->m_input && !task->m_ios.available())
+      park(*task);
+    else
+      schedule(*task);
+    task = next;
+    res += 1;
+  }
+
+  // Call idle hook with time to next wake time
+  if (m_ready == 0 && m_tasks != 0) idle(timeout());
+  return (res);
+}
+
+void FVM::Scheduler::idle(uint32_t ms)
+{
+  if (ms == 0) return;
+#if defined(__linux__)
+  if (m_fds != 0) {
+    poll(ms);
+    return;
+  }
+  struct timespec ts = { (time_t) (ms / 1000), (long) (ms % 1000) * 1000000L };
+  nanosleep(&ts, 0);
+#else
+  delay(ms);
+#endif
 }
 
 int FVM::interpret(task_t& task)
@@ -1860,7 +4959,7 @@ int FVM::interpret(task_t& task)
   }
   else if (res == -1) {
     char* endptr;
-    int value = strtol(buffer, &endptr, task.m_base == 10 ? 0 : task.m_base);
+    cell_t value = strtol(buffer, &endptr, task.m_base == 10 ? 0 : task.m_base);
     if (*endptr != 0) {
       task.m_ios.print(buffer);
       task.m_ios.println(F(" ??"));
@@ -1874,6 +4973,155 @@ int FVM::interpret(task_t& task)
   return (res);
 }
 
+int FVM::line(int op, task_t& task)
+{
+  int res;
+
+  // Execute control, base, key and trace tokens, and all tokens when
+  // traced or without line buffer, after the line
+  size_t room = ((uint8_t*) m_body + DICT_MAX) - m_line;
+  if (task.m_trace
+      || room < 4
+      || op <= OP_PLUS_LOOP
+      || op == OP_FOR
+      || op == OP_NEXT
+      || op == OP_HALT
+      || op == OP_SYSCALL
+      || op == OP_CALL
+      || op == OP_WLIT
+      || op == OP_TRACE
+      || op == OP_BASE
+      || op == OP_HEX
+      || op == OP_DECIMAL
+      || op == OP_QUESTION_KEY
+      || op == OP_KEY
+      || op == OP_TRACE_FILTER) {
+    if ((res = run_line(task)) < 0) return (res);
+    res = execute(op, task);
+    while (res > 0) res = resume(task);
+    return (res);
+  }
+
+  // Run line when full (token, prefix and halt)
+  if (room < m_lp + 4u && (res = run_line(task)) < 0) return (res);
+
+  // Compile token to line buffer
+  uint8_t* dp = m_dp;
+  m_dp = m_line + m_lp;
+  compile(op);
+  m_lp = m_dp - m_line;
+  m_dp = dp;
+
+  // Mark line that may change base before a following number
+  if (op >= KERNEL_MAX
+      || op == OP_STORE
+      || op == OP_PLUS_STORE
+      || op == OP_C_STORE
+      || op == OP_EXECUTE)
+    m_lbase = true;
+  return (0);
+}
+
+int FVM::line_literal(cell_t value, task_t& task)
+{
+  int res;
+
+  // Push literal without line buffer after line
+  const size_t LITERAL_MAX = 2 + sizeof(cell_t);
+  size_t room = ((uint8_t*) m_body + DICT_MAX) - m_line;
+  if (room < LITERAL_MAX) {
+    if ((res = run_line(task)) < 0) return (res);
+    task.push(value);
+    return (0);
+  }
+
+  // Run line when full (literal and halt)
+  if (room < m_lp + LITERAL_MAX && (res = run_line(task)) < 0)
+    return (res);
+
+  // Compile literal to line buffer
+  uint8_t* dp = m_dp;
+  m_dp = m_line + m_lp;
+  literal(value);
+  m_lp = m_dp - m_line;
+  m_dp = dp;
+  return (0);
+}
+
+int FVM::run_line(task_t& task)
+{
+  if (m_lp == 0) return (0);
+  m_line[m_lp] = OP_HALT;
+  m_lp = 0;
+  m_lbase = false;
+#if defined(ARDUINO_ARCH_AVR)
+  int res = execute((code_P) (m_line + CODE_P_MAX), task);
+#else
+  int res = execute((code_P) m_line, task);
+#endif
+  while (res > 0) res = resume(task);
+  return (res);
+}
+
+int FVM::evaluate(const char* src, size_t len, task_t& task)
+{
+  const char* end = src + len;
+  int res = 0;
+
+  while (true) {
+    // Skip white space and scan until white space
+    while (src < end && *src <= ' ') src++;
+    if (src == end) break;
+    const char* name = src;
+    while (src < end && *src > ' ') src++;
+    size_t n = src - name;
+
+    // Compile word to line buffer; run when full
+    int op = lookup(name, n);
+    if (op >= 0) {
+      if ((res = line(op, task)) < 0) return (res);
+      continue;
+    }
+
+    // Convert to number and push; base may be set in the line
+    if ((res = run_line_base(task)) < 0) return (res);
+    char buffer[32];
+    char* endptr = 0;
+    cell_t value = 0;
+    if (n < sizeof(buffer)) {
+      memcpy(buffer, name, n);
+      buffer[n] = 0;
+      value = strtol(buffer, &endptr, task.m_base == 10 ? 0 : task.m_base);
+    }
+    if (endptr == 0 || *endptr != 0) {
+      run_line(task);
+      task.m_ios.write((const uint8_t*) name, n);
+      task.m_ios.println(F(" ??"));
+      return (-1);
+    }
+    if ((res = line_literal(value, task)) < 0) return (res);
+  }
+  return (run_line(task));
+}
+
+#if defined(__linux__)
+int FVM::load(const char* path, task_t& task)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return (-1);
+  struct stat st;
+  void* src = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+    src = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (src == MAP_FAILED) return (-1);
+  madvise(src, st.st_size, MADV_SEQUENTIAL);
+  int res = evaluate((const char*) src, st.st_size, task);
+  munmap(src, st.st_size);
+  return (res);
+}
+#endif
+
 #if (FVM_KERNEL_DICT == 1)
 static const char EXIT_PSTR[] PROGMEM = "exit";
 static const char ZERO_EXIT_PSTR[] PROGMEM = "?exit";
@@ -1893,6 +5141,8 @@ static const char J_PSTR[] PROGMEM = "j";
 static const char LEAVE_PSTR[] PROGMEM = "leave";
 static const char LOOP_PSTR[] PROGMEM = "(loop)";
 static const char PLUS_LOOP_PSTR[] PROGMEM = "(+loop)";
+static const char FOR_PSTR[] PROGMEM = "(for)";
+static const char NEXT_PSTR[] PROGMEM = "(next)";
 static const char NOOP_PSTR[] PROGMEM = "noop";
 static const char EXECUTE_PSTR[] PROGMEM = "execute";
 static const char YIELD_PSTR[] PROGMEM = "yield";
@@ -1900,7 +5150,6 @@ static const char HALT_PSTR[] PROGMEM = "halt";
 static const char SYSCALL_PSTR[] PROGMEM = "(syscall)";
 static const char CALL_PSTR[] PROGMEM = "(call)";
 static const char TRACE_PSTR[] PROGMEM = "trace";
-static const char ROOM_PSTR[] PROGMEM = "room";
 
 static const char C_FETCH_PSTR[] PROGMEM = "c@";
 static const char C_STORE_PSTR[] PROGMEM = "c!";
@@ -1987,15 +5236,15 @@ static const char EQUALS_PSTR[] PROGMEM = "=";
 static const char GREATER_PSTR[] PROGMEM = ">";
 static const char U_LESS_PSTR[] PROGMEM = "u<";
 
-static const char LOOKUP_PSTR[] PROGMEM = "lookup";
-static const char TO_BODY_PSTR[] PROGMEM = ">body";
-static const char WORDS_PSTR[] PROGMEM = "words";
+static const char DUP_ZERO_BRANCH_PSTR[] PROGMEM = "(dup0branch)";
+static const char OVER_PLUS_PSTR[] PROGMEM = "over+";
+static const char OVER_MINUS_PSTR[] PROGMEM = "over-";
+static const char R_FETCH_PLUS_PSTR[] PROGMEM = "r@+";
+static const char R_FETCH_MINUS_PSTR[] PROGMEM = "r@-";
+static const char I_FETCH_PSTR[] PROGMEM = "i@";
+static const char CLIT_PLUS_PSTR[] PROGMEM = "(clit+)";
+static const char CLIT_EQUALS_PSTR[] PROGMEM = "(clit=)";
 
-static const char BASE_PSTR[] PROGMEM = "base";
-static const char HEX_PSTR[] PROGMEM = "hex";
-static const char DECIMAL_PSTR[] PROGMEM = "decimal";
-static const char QUESTION_KEY_PSTR[] PROGMEM = "?key";
-static const char KEY_PSTR[] PROGMEM = "key";
 static const char EMIT_PSTR[] PROGMEM = "emit";
 static const char CR_PSTR[] PROGMEM = "cr";
 static const char SPACE_PSTR[] PROGMEM = "space";
@@ -2004,9 +5253,9 @@ static const char U_DOT_PSTR[] PROGMEM = "u.";
 static const char DOT_PSTR[] PROGMEM = ".";
 static const char DOT_S_PSTR[] PROGMEM = ".s";
 static const char DOT_QUOTE_PSTR[] PROGMEM = "(.\")";
-static const char TYPE_PSTR[] PROGMEM = "type";
 static const char DOT_NAME_PSTR[] PROGMEM = ".name";
-static const char QUESTION_PSTR[] PROGMEM = "?";
+
+static const char WLIT_PSTR[] PROGMEM = "(wlit)";
 
 static const char MICROS_PSTR[] PROGMEM = "micros";
 static const char MILLIS_PSTR[] PROGMEM = "millis";
@@ -2017,6 +5266,27 @@ static const char DIGITALWRITE_PSTR[] PROGMEM = "digitalwrite";
 static const char DIGITALTOGGLE_PSTR[] PROGMEM = "digitaltoggle";
 static const char ANALOGREAD_PSTR[] PROGMEM = "analogread";
 static const char ANALOGWRITE_PSTR[] PROGMEM = "analogwrite";
+
+static const char LOOKUP_PSTR[] PROGMEM = "lookup";
+static const char TO_BODY_PSTR[] PROGMEM = ">body";
+static const char WORDS_PSTR[] PROGMEM = "words";
+
+static const char BASE_PSTR[] PROGMEM = "base";
+static const char HEX_PSTR[] PROGMEM = "hex";
+static const char DECIMAL_PSTR[] PROGMEM = "decimal";
+static const char QUESTION_KEY_PSTR[] PROGMEM = "?key";
+static const char KEY_PSTR[] PROGMEM = "key";
+
+static const char CACHE_PSTR[] PROGMEM = "(cache)";
+
+static const char PROFILE_PSTR[] PROGMEM = "profile";
+
+static const char TRACE_FILTER_PSTR[] PROGMEM = "trace-filter";
+
+static const char QUESTION_PSTR[] PROGMEM = "?";
+static const char TYPE_PSTR[] PROGMEM = "type";
+
+static const char ROOM_PSTR[] PROGMEM = "room";
 #endif
 
 const str_P FVM::opstr[] PROGMEM = {
@@ -2046,7 +5316,7 @@ const str_P FVM::opstr[] PROGMEM = {
   (str_P) SYSCALL_PSTR,
   (str_P) CALL_PSTR,
   (str_P) TRACE_PSTR,
-  (str_P) ROOM_PSTR,
+  (str_P) FOR_PSTR,
 
   (str_P) C_FETCH_PSTR,
   (str_P) C_STORE_PSTR,
@@ -2131,15 +5401,15 @@ const str_P FVM::opstr[] PROGMEM = {
   (str_P) GREATER_PSTR,
   (str_P) U_LESS_PSTR,
 
-  (str_P) LOOKUP_PSTR,
-  (str_P) TO_BODY_PSTR,
-  (str_P) WORDS_PSTR,
+  (str_P) DUP_ZERO_BRANCH_PSTR,
+  (str_P) OVER_PLUS_PSTR,
+  (str_P) OVER_MINUS_PSTR,
+  (str_P) R_FETCH_PLUS_PSTR,
+  (str_P) R_FETCH_MINUS_PSTR,
+  (str_P) I_FETCH_PSTR,
+  (str_P) CLIT_PLUS_PSTR,
+  (str_P) CLIT_EQUALS_PSTR,
 
-  (str_P) BASE_PSTR,
-  (str_P) HEX_PSTR,
-  (str_P) DECIMAL_PSTR,
-  (str_P) QUESTION_KEY_PSTR,
-  (str_P) KEY_PSTR,
   (str_P) EMIT_PSTR,
   (str_P) CR_PSTR,
   (str_P) SPACE_PSTR,
@@ -2148,9 +5418,10 @@ const str_P FVM::opstr[] PROGMEM = {
   (str_P) DOT_PSTR,
   (str_P) DOT_S_PSTR,
   (str_P) DOT_QUOTE_PSTR,
-  (str_P) TYPE_PSTR,
+  (str_P) NEXT_PSTR,
   (str_P) DOT_NAME_PSTR,
-  (str_P) QUESTION_PSTR,
+
+  (str_P) WLIT_PSTR,
 
   (str_P) MICROS_PSTR,
   (str_P) MILLIS_PSTR,
@@ -2161,6 +5432,27 @@ const str_P FVM::opstr[] PROGMEM = {
   (str_P) DIGITALTOGGLE_PSTR,
   (str_P) ANALOGREAD_PSTR,
   (str_P) ANALOGWRITE_PSTR,
+
+  (str_P) LOOKUP_PSTR,
+  (str_P) TO_BODY_PSTR,
+  (str_P) WORDS_PSTR,
+
+  (str_P) BASE_PSTR,
+  (str_P) HEX_PSTR,
+  (str_P) DECIMAL_PSTR,
+  (str_P) QUESTION_KEY_PSTR,
+  (str_P) KEY_PSTR,
+
+  (str_P) CACHE_PSTR,
+
+  (str_P) PROFILE_PSTR,
+
+  (str_P) TRACE_FILTER_PSTR,
+
+  (str_P) QUESTION_PSTR,
+  (str_P) TYPE_PSTR,
+
+  (str_P) ROOM_PSTR,
 #endif
   0
 };
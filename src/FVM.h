@@ -26,6 +26,66 @@
 
 #include <Arduino.h>
 
+/**
+ * Cell width in bits. Cells are 16-bit on AVR. Other targets may
+ * select 16, 32 or 64-bit cells, e.g. -DFVM_CELL=16 to simulate AVR
+ * images on a host. The double cell is twice the cell width (64-bit
+ * cells require a compiler with 128-bit integers).
+ * 16: 16-bit cells (default on AVR).
+ * 32: 32-bit cells (default on other targets).
+ * 64: 64-bit cells.
+ */
+#if defined(ARDUINO_ARCH_AVR)
+#undef FVM_CELL
+#define FVM_CELL 16
+#elif !defined(FVM_CELL)
+#define FVM_CELL 32
+#endif
+
+/**
+ * Cell addresses. When a pointer does not fit in a cell (e.g. 32-bit
+ * cells on a 64-bit host) cells hold the offset from the kernel
+ * origin (FVM::s_origin) and are translated to pointers by the memory
+ * operations. Data addressed by cells must be within 2 Gbyte of the
+ * origin, i.e. in static storage or on the heap; 32 Kbyte with
+ * 16-bit cells. Convert with FVM::address() and FVM::pointer().
+ * 0: Cells hold pointers.
+ * 1: Cells hold offsets from the origin (default on hosts with
+ *    pointers wider than cells).
+ */
+#if !defined(FVM_OFFSET)
+#if !defined(ARDUINO_ARCH_AVR)					\
+  && ((FVM_CELL == 16) || (FVM_CELL == 32 && UINTPTR_MAX > UINT32_MAX))
+#define FVM_OFFSET 1
+#else
+#define FVM_OFFSET 0
+#endif
+#endif
+
+/**
+ * Cell address of given pointer for static initialization.
+ * @param[in] ptr pointer.
+ */
+#if (FVM_OFFSET == 1)
+#define FVM_ADDRESS(ptr)						\
+  (FVM::cell_t) ((intptr_t) (ptr) - (intptr_t) FVM::s_origin)
+#else
+#define FVM_ADDRESS(ptr) (FVM::cell_t) (intptr_t) (ptr)
+#endif
+
+/**
+ * Enable instruction budget (fuel) for preemption. The budget given
+ * to resume is decremented on backward branches, loops and calls.
+ * When the budget is used the task state is saved as for yield and
+ * resume returns preempted(2). Native code is disabled. Sketches
+ * that preempt tasks may check the setting.
+ * 0: No budget.
+ * 1: Budget checked on backward branches, loops and calls.
+ */
+#if !defined(FVM_FUEL)
+#define FVM_FUEL 0
+#endif
+
 /**
  * String in program memory.
  */
@@ -33,6 +93,10 @@ typedef const PROGMEM char* str_P;
 
 class FVM {
  public:
+  /**
+   * Kernel operation codes (OPS). The codes changed in version 1.2;
+   * token code generated with earlier versions must be regenerated.
+   */
   enum {
     /*
      * Control structure and literals
@@ -59,10 +123,11 @@ class FVM {
     OP_EXECUTE = 19,		//!< Execute operation token
     OP_HALT = 20,		//!< Halt virtual machine
     OP_YIELD = 21,		//!< Yield virtual machine
-    OP_SYSCALL = 22,		//!< Call system token
+    OP_SYSCALL = 22,		//!< Call system token or long branch
     OP_CALL = 23,		//!< Call application token
     OP_TRACE = 24,		//!< Set trace mode
-    OP_ROOM = 25,		//!< Dictionary state
+    OP_FOR = 25,		//!< Start down counting loop block
+    OP_NEXT = 118,		//!< End down counting loop block
 
     /*
      * Memory access
@@ -173,20 +238,20 @@ class FVM {
     OP_U_LESS = 101,		//!< Unsigned less than
 
     /*
-     * Dictionary functions
+     * Superinstructions
      */
-    OP_LOOKUP = 102,		//!< Lookup word in dictionary
-    OP_TO_BODY = 103,		//!< Access data area application variable
-    OP_WORDS = 104,		//!< List dictionaries
+    OP_DUP_ZERO_BRANCH = 102,	//!< Branch zero equal/false and keep flag
+    OP_OVER_PLUS = 103,		//!< Add next top of stack
+    OP_OVER_MINUS = 104,	//!< Substract next top of stack
+    OP_R_FETCH_PLUS = 105,	//!< Add copy from return stack
+    OP_R_FETCH_MINUS = 106,	//!< Substract copy from return stack
+    OP_I_FETCH = 107,		//!< Load data at loop index
+    OP_CLIT_PLUS = 108,		//!< Add inline literal (signed byte)
+    OP_CLIT_EQUALS = 109,	//!< Equal inline literal (signed byte)
 
     /*
      * Basic I/O
      */
-    OP_BASE = 105,		//!< Base for number conversion
-    OP_HEX = 106,		//!< Set hexa-decimal number conversion base
-    OP_DECIMAL = 107,		//!< Set decimal number conversion base
-    OP_QUESTION_KEY = 108,	//!< Read character if available
-    OP_KEY = 109,		//!< Wait for character and read
     OP_EMIT = 110,		//!< Print character
     OP_CR = 111,		//!< Print new-line
     OP_SPACE = 112,		//!< Print space
@@ -195,9 +260,12 @@ class FVM {
     OP_DOT = 115,		//!< Print top of stack
     OP_DOT_S = 116,		//!< Print contents of parameter stack
     OP_DOT_QUOTE = 117,		//!< Print program memory string
-    OP_TYPE = 118,		//!< Print string
     OP_DOT_NAME = 119,		//!< Print name of token
-    OP_QUESTION = 120,		//!< Print value of variable
+
+    /*
+     * Cell width literal
+     */
+    OP_WLIT = 120,		//!< Inline literal constant (cell width)
 
     /*
      * Arduino extensions
@@ -212,6 +280,48 @@ class FVM {
     OP_ANALOGREAD = 128,	//!< Read analog pin
     OP_ANALOGWRITE = 129,	//!< Write pwm pin
 
+    /*
+     * Dictionary functions
+     */
+    OP_LOOKUP = 130,		//!< Lookup word in dictionary
+    OP_TO_BODY = 131,		//!< Access data area application variable
+    OP_WORDS = 132,		//!< List dictionaries
+
+    /*
+     * Number conversion and input
+     */
+    OP_BASE = 133,		//!< Base for number conversion
+    OP_HEX = 134,		//!< Set hexa-decimal number conversion base
+    OP_DECIMAL = 135,		//!< Set decimal number conversion base
+    OP_QUESTION_KEY = 136,	//!< Read character if available
+    OP_KEY = 137,		//!< Wait for character and read
+
+    /*
+     * Pre-decoded code
+     */
+    OP_CACHE = 138,		//!< Continue pre-decoded code
+
+    /*
+     * Profiler
+     */
+    OP_PROFILE = 139,		//!< Print profile
+
+    /*
+     * Trace filter
+     */
+    OP_TRACE_FILTER = 140,	//!< Set trace filter
+
+    /*
+     * Basic I/O (extended)
+     */
+    OP_QUESTION = 141,		//!< Print value of variable
+    OP_TYPE = 142,		//!< Print string
+
+    /*
+     * Dictionary functions (extended)
+     */
+    OP_ROOM = 143,		//!< Dictionary state
+
     /** 0..127: direct kernel words/switch, PROGMEM. */
     CORE_MAX = 128,
 
@@ -225,17 +335,24 @@ class FVM {
     TOKEN_MAX = 511
   };
 
-  /** Cell and double data type. */
-#if defined(ARDUINO_ARCH_AVR)
+  /** Cell and double data type (FVM_CELL). */
+#if (FVM_CELL == 16)
   typedef int16_t cell_t;
   typedef uint16_t ucell_t;
   typedef int32_t cell2_t;
   typedef uint32_t ucell2_t;
-#else
+#elif (FVM_CELL == 32)
   typedef int32_t cell_t;
   typedef uint32_t ucell_t;
   typedef int64_t cell2_t;
   typedef uint64_t ucell2_t;
+#elif (FVM_CELL == 64)
+  typedef int64_t cell_t;
+  typedef uint64_t ucell_t;
+  typedef __int128 cell2_t;
+  typedef unsigned __int128 ucell2_t;
+#else
+#error "FVM.h: FVM_CELL must be 16, 32 or 64"
 #endif
 
   /**
@@ -248,14 +365,117 @@ class FVM {
   typedef int8_t code_t;
   typedef const PROGMEM code_t* code_P;
 
+  /**
+   * Task output buffer. Batches output to the task stream; drained at
+   * cr, when more than half full and when the task yields, and flushed
+   * when the task halts. Data that the stream does not accept (short
+   * write) is kept in the buffer, and the task yields. Writes to the
+   * stream directly without buffer.
+   */
+  class Output : public Print {
+  public:
+    /**
+     * Construct output for given stream without buffer.
+     * @param[in] ios output stream.
+     */
+    Output(Stream& ios) :
+      m_ios(ios),
+      m_buf(0),
+      m_size(0),
+      m_count(0)
+    {}
+
+    /**
+     * Set output buffer.
+     * @param[in] buf buffer.
+     * @param[in] size of buffer.
+     */
+    void buffer(uint8_t* buf, uint8_t size)
+    {
+      m_buf = buf;
+      m_size = size;
+      m_count = 0;
+    }
+
+    /**
+     * Return true if output is buffered.
+     * @return bool.
+     */
+    bool buffered()
+    {
+      return (m_size != 0);
+    }
+
+    /**
+     * Return true if more than half of the buffer is used and could
+     * not be drained; the task should yield.
+     * @return bool.
+     */
+    bool busy()
+    {
+      return (m_count > (m_size >> 1) && !drain());
+    }
+
+    /**
+     * Write buffered output that the stream accepts. Return true if
+     * at most half of the buffer is used after the write.
+     * @return bool.
+     */
+    bool drain();
+
+    /**
+     * Write all buffered output to the stream.
+     */
+    virtual void flush();
+
+    /**
+     * Write character to buffer; drained when full.
+     * @param[in] c character.
+     * @return number of characters.
+     */
+    virtual size_t write(uint8_t c);
+
+    /**
+     * Write given data to buffer; drained when full.
+     * @param[in] buf data.
+     * @param[in] size of data.
+     * @return number of characters.
+     */
+    virtual size_t write(const uint8_t* buf, size_t size);
+
+  protected:
+    Stream& m_ios;
+    uint8_t* m_buf;
+    uint8_t m_size;
+    uint8_t m_count;
+  };
+
   struct task_t {
     Stream& m_ios;		//!< Input/Output stream.
+    Output m_out;		//!< Output buffer.
     cell_t m_base;		//!< Number conversion base.
     bool m_trace;		//!< Trace mode.
     code_P* m_rp;		//!< Return stack pointer.
     code_P* m_rp0;		//!< Return stack bottom pointer.
     cell_t* m_sp;		//!< Parameter stack pointer.
     cell_t* m_sp0;		//!< Parameter stack bottom pointer.
+    uint16_t m_filter;		//!< Trace filter token (or zero).
+    uint8_t m_extent;		//!< Trace filter call depth plus one.
+    uint8_t m_depth_min;	//!< Trace filter return stack depth.
+    uint8_t m_depth_max;	//!< Trace filter return stack depth.
+    uint8_t m_period;		//!< Trace filter every nth instruction.
+    uint8_t m_count;		//!< Trace filter instruction count.
+    uint32_t m_wake;		//!< Wake time (milli-seconds, delay).
+    task_t* m_link;		//!< Scheduler queue link.
+    bool m_input;		//!< Waiting for input (key).
+    uint8_t m_scan;		//!< Scanned token length (scan).
+#if !defined(ARDUINO_ARCH_AVR)
+    int16_t m_node;		//!< Call graph node (profiler).
+    uint16_t m_lost;		//!< Call depth not in call graph.
+#endif
+#if defined(__linux__)
+    int m_fd;			//!< Input file descriptor (scheduler).
+#endif
 
     /**
      * Construct task with given in-/output stream, stacks and
@@ -268,6 +488,7 @@ class FVM {
      */
     task_t(Stream&ios, cell_t* sp0, code_P* rp0, code_P fn) :
       m_ios(ios),
+      m_out(ios),
       m_base(10),
       m_trace(false),
       m_rp(rp0),
@@ -275,6 +496,18 @@ class FVM {
       m_sp(sp0 + 1),
       m_sp0(sp0)
     {
+      trace_filter(0);
+      m_wake = 0;
+      m_link = 0;
+      m_input = false;
+      m_scan = 0;
+#if !defined(ARDUINO_ARCH_AVR)
+      m_node = 0;
+      m_lost = 0;
+#endif
+#if defined(__linux__)
+      m_fd = -1;
+#endif
       *++m_rp = fn;
     }
 
@@ -323,6 +556,27 @@ class FVM {
       m_trace = flag;
     }
 
+    /**
+     * Set trace filter. Trace only within call of given token (zero
+     * for all), return stack depth range and every nth instruction.
+     * Default is no filter.
+     * @param[in] token to trace.
+     * @param[in] min return stack depth (default 0).
+     * @param[in] max return stack depth (default 255).
+     * @param[in] nth instruction (default 1).
+     */
+    void trace_filter(uint16_t token,
+		      uint8_t min = 0, uint8_t max = 255,
+		      uint8_t nth = 1)
+    {
+      m_filter = token;
+      m_extent = 0;
+      m_depth_min = min;
+      m_depth_max = max;
+      m_period = nth;
+      m_count = 0;
+    }
+
     /**
      * Set task instruction pointer to given threaded code pointer.
      * @param[in] fn threaded code pointer.
@@ -335,20 +589,134 @@ class FVM {
     }
   };
 
-  template<int PARAMETER_STACK_MAX, int RETURN_STACK_MAX>
+  template<int PARAMETER_STACK_MAX,
+	   int RETURN_STACK_MAX,
+	   int OUTPUT_MAX = 0>
   struct Task : task_t {
     cell_t m_params[PARAMETER_STACK_MAX];
     code_P m_returns[RETURN_STACK_MAX];
+    uint8_t m_output[OUTPUT_MAX > 0 ? OUTPUT_MAX : 1];
 
     /**
      * Construct task with given in-/output stream and threaded code
-     * pointer.
+     * pointer. Output is buffered when the output buffer size is
+     * given (OUTPUT_MAX, 2..255 bytes).
      * @param[in] ios in-/output stream.
      * @param[in] fn threaded code pointer (default none).
      */
     Task(Stream& ios, code_P fn = 0) :
     task_t(ios, m_params, m_returns, fn)
-    {}
+    {
+      if (OUTPUT_MAX > 0) m_out.buffer(m_output, OUTPUT_MAX);
+    }
+  };
+
+  /**
+   * Task scheduler with ready queue and timer wheel. Ready tasks are
+   * resumed in order. A task that yields in delay is parked in the
+   * timer wheel until the wake time. A task that yields in key is
+   * parked until the input stream has data; polled with available(),
+   * or on Linux with epoll when the task is added with a file
+   * descriptor. Tasks that halt are removed. The idle hook is called
+   * with the time to the next wake time when no task is ready.
+   */
+  class Scheduler {
+  public:
+    /**
+     * Construct scheduler for given virtual machine and instruction
+     * budget per resume (FVM_FUEL). Tasks that are preempted are
+     * scheduled again.
+     * @param[in] fvm virtual machine.
+     * @param[in] budget instruction budget (default 0, none).
+     */
+    Scheduler(FVM& fvm, uint32_t budget = 0);
+
+    /**
+     * Add given task to scheduler.
+     * @param[in] task to add.
+     */
+    void add(task_t& task);
+
+#if defined(__linux__)
+    /**
+     * Add given task to scheduler with file descriptor of the task
+     * input stream. The task is woken by epoll when parked in key.
+     * @param[in] task to add.
+     * @param[in] fd input file descriptor.
+     */
+    void add(task_t& task, int fd);
+#endif
+
+    /**
+     * Resume ready tasks once. Tasks with passed wake time are moved
+     * from the timer wheel to the ready queue. Call idle hook if no
+     * task is ready. Returns number of resumed tasks.
+     * @return number of tasks.
+     */
+    int run();
+
+    /**
+     * Number of tasks in scheduler.
+     * @return number of tasks.
+     */
+    int tasks()
+    {
+      return (m_tasks);
+    }
+
+    /**
+     * Idle hook; called when no task is ready with number of
+     * milli-seconds to next wake time. Default sleeps (epoll on
+     * Linux otherwise delay).
+     * @param[in] ms milli-seconds to next wake time.
+     */
+    virtual void idle(uint32_t ms);
+
+    /**
+     * Move tasks parked in key to the ready queue when the input
+     * stream has data. Wait at most given number of milli-seconds for
+     * file descriptor input (Linux).
+     * @param[in] ms milli-seconds to wait (default none).
+     */
+    void poll(uint32_t ms = 0);
+
+  protected:
+#if defined(ARDUINO_ARCH_AVR)
+    static const int WHEEL_MAX = 8;
+#else
+    static const int WHEEL_MAX = 256;
+#endif
+    FVM& m_fvm;			//!< Virtual machine.
+    uint32_t m_budget;		//!< Instruction budget per resume.
+    task_t* m_ready;		//!< Ready queue head.
+    task_t* m_last;		//!< Ready queue tail.
+    task_t* m_wheel[WHEEL_MAX];	//!< Timer wheel; tasks per wake time.
+    task_t* m_input;		//!< Tasks waiting for input (polled).
+#if defined(__linux__)
+    int m_epoll;		//!< Epoll file descriptor (or -1).
+    int m_fds;			//!< Number of tasks waiting in epoll.
+#endif
+    uint32_t m_time;		//!< Timer wheel time.
+    int m_tasks;		//!< Number of tasks.
+
+    /**
+     * Add given task to ready queue, or timer wheel if the wake time
+     * has not passed.
+     * @param[in] task to schedule.
+     */
+    void schedule(task_t& task);
+
+    /**
+     * Park given task until the input stream has data.
+     * @param[in] task to park.
+     */
+    void park(task_t& task);
+
+    /**
+     * Milli-seconds to next wake time in timer wheel (max WHEEL_MAX).
+     * @return milli-seconds.
+     */
+    uint32_t timeout();
   };
 
   /**
@@ -357,7 +725,7 @@ class FVM {
   struct obj_t {
     code_t op;			//!< CALL(FN).
     code_t noop;		//!< OP_NOOP.
-    cell_t* value;		//!< Pointer to value (SRAM).
+    cell_t value;		//!< Address of value (SRAM).
   } __attribute__((packed));
 
   /**
@@ -365,7 +733,7 @@ class FVM {
    */
   struct var_t {
     code_t op;			//!< OP_VAR/OP_CONST.
-    cell_t* value;		//!< Pointer to value (SRAM).
+    cell_t value;		//!< Address of value (SRAM).
   } __attribute__((packed));
 
   /**
@@ -387,6 +755,66 @@ class FVM {
     void* env;			//!< Pointer to environment (SRAM).
   } __attribute__((packed));
 
+#if !defined(ARDUINO_ARCH_AVR)
+  /**
+   * Pre-decoded threaded code for dynamic dictionary words. Handler
+   * address followed by optional operand.
+   */
+  union xcode_t {
+    const void* op;		//!< Handler address.
+    cell_t value;		//!< Literal value or operation code.
+    xcode_t* xp;		//!< Pre-decoded code pointer.
+    code_P ip;			//!< Threaded code pointer.
+  };
+
+  /**
+   * Profile; estimated token dispatch counts, sampled ticks (cycles or
+   * micro-seconds) and number of samples per token, and histogram of
+   * sampled ticks per token (log2 buckets).
+   */
+  struct profile_t {
+    uint32_t count[TOKEN_MAX + 1]; //!< Estimated dispatch count per token.
+    uint32_t samples[TOKEN_MAX + 1]; //!< Number of samples per token.
+    uint64_t ticks[TOKEN_MAX + 1]; //!< Sampled ticks per token.
+    uint32_t histogram[32];	//!< Samples per log2(ticks).
+  };
+
+  /**
+   * Call graph; tree of word calls per call path with number of
+   * calls and exclusive ticks. Inclusive ticks are summed when the
+   * graph is read. Node zero is the root (task level).
+   */
+  static const int GRAPH_MAX = 1024;
+  struct graph_t {
+    struct node_t {
+      uint16_t token;		//!< Word token.
+      int16_t parent;		//!< Calling node.
+      int16_t child;		//!< First called node (or zero).
+      int16_t sibling;		//!< Next node with same parent (or zero).
+      uint32_t calls;		//!< Number of calls.
+      uint64_t ticks;		//!< Exclusive ticks.
+      uint64_t inclusive;	//!< Inclusive ticks (summed on read).
+    };
+    uint16_t nodes;		//!< Number of nodes.
+    node_t node[GRAPH_MAX];	//!< Nodes; root first.
+  };
+
+  /**
+   * Binary trace record; written to ring buffer before each
+   * instruction of a traced task (FVM_TRACE 3 in FVM.cpp).
+   */
+  static const int TRACE_MAX = 1024;
+  struct trace_t {
+    const task_t* task;		//!< Task.
+    code_P ip;			//!< Instruction pointer.
+    uint32_t time;		//!< Micro-seconds.
+    uint16_t token;		//!< Token (0..511).
+    uint8_t depth;		//!< Return stack depth.
+    uint8_t size;		//!< Parameter stack depth.
+    cell_t tos;			//!< Top of stack.
+  };
+#endif
+
   /**
    * Construct forth virtual machine with given data area and dynamic
    * dictionary.
@@ -399,14 +827,31 @@ class FVM {
     WORD_MAX(words),
     m_next(0),
     m_dp(dp0),
-    m_dp0(dp0)
+    m_dp0(dp0),
+    m_line(dp0 + bytes),
+    m_lp(0),
+    m_lbase(false)
   {
     m_body = (code_t**) dp0;
     m_name = 0;
+    if (bytes >= 4 * LINE_MAX) m_line -= LINE_MAX;
+#if !defined(ARDUINO_ARCH_AVR)
+    m_xcode = 0;
+    m_xdp = (xcode_t*) m_line;
+    m_jit = 0;
+    m_jp0 = 0;
+    m_jp = 0;
+    index_names();
+#endif
     if (words == 0) return;
     dp0 += sizeof(code_t**) * words;
     m_name = (char**) dp0;
     dp0 += sizeof(char**) * words;
+#if !defined(ARDUINO_ARCH_AVR)
+    m_xcode = (xcode_t**) dp0;
+    dp0 += sizeof(xcode_t**) * words;
+    forget_xcode();
+#endif
     m_dp = dp0;
     m_dp0 = dp0;
   }
@@ -429,6 +874,21 @@ class FVM {
     m_dp = dp;
   }
 
+  /**
+   * Get number of bytes used by pre-decoded code in the end of the
+   * data area; zero when no words are translated.
+   * @return bytes.
+   */
+  size_t cached()
+  {
+#if !defined(ARDUINO_ARCH_AVR)
+    uintptr_t end = (uintptr_t) m_line;
+    return ((end & ~(sizeof(xcode_t) - 1)) - (uintptr_t) m_xdp);
+#else
+    return (0);
+#endif
+  }
+
   /**
    * Allocate and copy given operation code to data area.
    * @param[in] op operation code (token).
@@ -454,9 +914,14 @@ class FVM {
    * Compile literal to data area.
    * @param[in] val literal value.
    */
-  void literal(int val)
+  void literal(cell_t val)
   {
-    if (val < INT8_MIN || val > INT8_MAX) {
+    if (val < INT16_MIN || val > INT16_MAX) {
+      *m_dp++ = OP_WLIT;
+      for (size_t i = 0; i < sizeof(cell_t); i++, val >>= 8)
+	*m_dp++ = val;
+    }
+    else if (val < INT8_MIN || val > INT8_MAX) {
       *m_dp++ = OP_LIT;
       *m_dp++ = val;
       *m_dp++ = val >> 8;
@@ -467,6 +932,16 @@ class FVM {
     }
   }
 
+  /**
+   * Peephole optimize the latest word in the dynamic dictionary.
+   * Long branches are relaxed to short when the offset allows, token
+   * sequences are rewritten to superinstructions, and branch offsets
+   * adjusted. Should be called when the definition is completed
+   * (i.e. all branches are resolved).
+   * @return number of rewrites.
+   */
+  int optimize();
+
   /**
    * Create word in dictionary. Initiate body reference to the dynamic
    * dictionary.
@@ -482,6 +957,8 @@ class FVM {
     m_body[m_next] = (code_t*) (m_dp + CODE_P_MAX);
 #else
     m_body[m_next] = (code_t*) m_dp;
+    m_xcode[m_next] = 0;
+    index_name(m_next);
 #endif
     m_next += 1;
     return (true);
@@ -495,12 +972,8 @@ class FVM {
   {
     if (!create(name)) return (false);
     *m_dp++ = OP_VAR;
-    *m_dp++ = 0;
-    *m_dp++ = 0;
-#if !defined(ARDUINO_ARCH_AVR)
-    *m_dp++ = 0;
-    *m_dp++ = 0;
-#endif
+    for (size_t i = 0; i < sizeof(cell_t); i++)
+      *m_dp++ = 0;
     return (true);
   }
 
@@ -509,16 +982,12 @@ class FVM {
    * @param[in] name string.
    * @param[in] val value.
    */
-  bool constant(const char* name, int val)
+  bool constant(const char* name, cell_t val)
   {
     if (!create(name)) return (false);
     *m_dp++ = OP_CONST;
-    *m_dp++ = val;
-    *m_dp++ = val >> 8;
-#if !defined(ARDUINO_ARCH_AVR)
-    *m_dp++ = val >> 16;
-    *m_dp++ = val >> 24;
-#endif
+    for (size_t i = 0; i < sizeof(cell_t); i++, val >>= 8)
+      *m_dp++ = val;
     return (true);
   }
 
@@ -555,6 +1024,10 @@ class FVM {
     if (op < 0 || op > m_next) return (false);
     m_dp = (uint8_t*) m_name[op];
     m_next = op;
+#if !defined(ARDUINO_ARCH_AVR)
+    forget_xcode();
+    index_names();
+#endif
     return (true);
   }
 
@@ -567,21 +1040,48 @@ class FVM {
    */
   int scan(char* bp, task_t& task);
 
+  /**
+   * Scan available input to given buffer without blocking. Return
+   * break character when the token is complete, otherwise negative
+   * (-1) and the scan continues with the next call with the same
+   * buffer.
+   * @param[in] bp buffer pointer.
+   * @param[in] task stream to use.
+   * @return break character or negative (more input required).
+   */
+  int scan_available(char* bp, task_t& task);
+
   /**
    * Lookup given string in dictionary. Return token otherwise
    * negative error code(-1).
    * @param[in] name string.
    * @return toker or negative error code.
    */
-  int lookup(const char* name);
+  int lookup(const char* name)
+  {
+    return (lookup(name, strlen(name)));
+  }
+
+  /**
+   * Lookup given string with given length (not null terminated) in
+   * dictionary. Return token otherwise negative error code(-1).
+   * @param[in] name string.
+   * @param[in] len length of string.
+   * @return token or negative error code.
+   */
+  int lookup(const char* name, size_t len);
 
   /**
-   * Resume task in virtual machine with given task. Return yield(1),
-   * halt(0), or error code(-1).
+   * Resume task in virtual machine with given task and instruction
+   * budget; number of backward branches, loops and calls before the
+   * task is preempted (FVM_FUEL). Return yield(1), halt(0),
+   * preempted(2), or error code(-1). A non-zero budget is an error
+   * when the budget is not enabled (FVM_FUEL 0).
    * @param[in] task to resume.
+   * @param[in] budget instruction budget (default 0, none).
    * @return error code.
    */
-  int resume(task_t& task);
+  int resume(task_t& task, uint32_t budget = 0);
 
   /**
    * Execute given token with given task.
@@ -624,6 +1124,154 @@ class FVM {
    */
   int interpret(task_t& task);
 
+  /**
+   * Evaluate given source buffer; scan, lookup and execute or push
+   * number until end of buffer or error. Tokens are scanned in the
+   * buffer without copy. Returns on end of buffer with the latest
+   * result, halt(0), or on unknown word or illegal instruction (-1).
+   * @param[in] src source buffer.
+   * @param[in] len length of source buffer.
+   * @param[in] task to run.
+   * @return error code.
+   */
+  int evaluate(const char* src, size_t len, task_t& task);
+
+  /**
+   * Compile given token to the line buffer in the end of the data
+   * area. The line is run with the given task when the buffer is
+   * full, and by run_line(). Control, base, key and trace tokens are
+   * executed directly after the line, as are all tokens when the
+   * task is traced or there is no line buffer. Returns halt(0) or
+   * illegal instruction (-1).
+   * @param[in] op token to compile.
+   * @param[in] task to run.
+   * @return error code.
+   */
+  int line(int op, task_t& task);
+
+  /**
+   * Compile given literal to the line buffer. Without line buffer
+   * the literal is pushed after the line is run. Returns halt(0) or
+   * illegal instruction (-1).
+   * @param[in] value literal value.
+   * @param[in] task to run.
+   * @return error code.
+   */
+  int line_literal(cell_t value, task_t& task);
+
+  /**
+   * Run line buffer with given task until halt or error, and reclaim
+   * the buffer. Returns halt(0) or illegal instruction (-1).
+   * @param[in] task to run.
+   * @return error code.
+   */
+  int run_line(task_t& task);
+
+  /**
+   * Run line buffer with given task when the pending line may change
+   * the number conversion base (store, execute or application word).
+   * Call before number conversion of a word that was not found.
+   * Returns halt(0) or illegal instruction (-1).
+   * @param[in] task to run.
+   * @return error code.
+   */
+  int run_line_base(task_t& task)
+  {
+    return (m_lbase ? run_line(task) : 0);
+  }
+
+#if defined(__linux__)
+  /**
+   * Load source file; map file to memory and evaluate. Returns
+   * negative error code(-1) if the file could not be mapped,
+   * otherwise as evaluate().
+   * @param[in] path file name.
+   * @param[in] task to run.
+   * @return error code.
+   */
+  int load(const char* path, task_t& task);
+#endif
+
+#if !defined(ARDUINO_ARCH_AVR)
+  /**
+   * Get profile. Returns null if the profiler is not enabled
+   * (FVM_PROFILER in FVM.cpp).
+   * @return profile or null.
+   */
+  static const profile_t* profile();
+
+  /**
+   * Get call graph. Returns null if the call graph profiler is not
+   * enabled (FVM_PROFILER in FVM.cpp).
+   * @return call graph or null.
+   */
+  static const graph_t* graph();
+
+  /**
+   * Print call graph in folded stacks format; call path (word names
+   * separated by semicolon) and exclusive ticks per line. This is the
+   * input format of flame graph tools.
+   * @param[in] ios output stream.
+   */
+  void print_graph(Stream& ios);
+
+  /**
+   * Reset profile counters and call graph. Tasks should be halted
+   * (not in a word) as their call graph node is not reset.
+   */
+  static void profile_reset();
+
+  /**
+   * Get binary trace ring buffer and number of written records. The
+   * latest record is at index (count - 1) % TRACE_MAX. Returns null
+   * if binary trace is not enabled (FVM_TRACE in FVM.cpp).
+   * @param[out] count number of written records.
+   * @return ring buffer or null.
+   */
+  static const trace_t* trace_buffer(uint32_t& count);
+
+  /**
+   * Print given binary trace ring buffer and number of written
+   * records in symbolic trace format; task, micro-seconds since
+   * previous record of task, instruction pointer, return stack
+   * depth, token name, parameter stack depth and top of stack. The
+   * buffer may be a copy dumped from another machine with the same
+   * dictionary.
+   * @param[in] ios output stream.
+   * @param[in] buf ring buffer.
+   * @param[in] count number of written records.
+   */
+  void print_trace(Stream& ios, const trace_t* buf, uint32_t count);
+#endif
+
+  /**
+   * Return cell address of given pointer; the pointer, or the offset
+   * from the origin (FVM_OFFSET).
+   * @param[in] ptr pointer.
+   * @return cell address.
+   */
+  static cell_t address(const void* ptr)
+  {
+    return (FVM_ADDRESS(ptr));
+  }
+
+  /**
+   * Return pointer for given cell address.
+   * @param[in] addr cell address.
+   * @return pointer.
+   */
+  static void* pointer(cell_t addr)
+  {
+#if (FVM_OFFSET == 1)
+    return ((void*) ((intptr_t) s_origin + addr));
+#else
+    return ((void*) (intptr_t) addr);
+#endif
+  }
+
+  // Origin of cell addresses (FVM_OFFSET)
+  static uint8_t s_origin[];
+
   // Threaded code and dictionary to be provided by sketch (program memory)
   static const code_P fntab[] PROGMEM;
   static const str_P fnstr[] PROGMEM;
@@ -644,8 +1292,145 @@ class FVM {
   uint8_t m_next;
   uint8_t* m_dp;
   uint8_t* m_dp0;
+  uint8_t* m_line;
+  uint8_t m_lp;
+  bool m_lbase;
   code_t** m_body;
   char** m_name;
+
+  // Line buffer size (bytes); reserved in the end of the data area
+  static const int LINE_MAX = 64;
+
+#if !defined(ARDUINO_ARCH_AVR)
+  // Pre-decoded code for dynamic dictionary; allocated from the end
+  // of the data area
+  xcode_t** m_xcode;
+  xcode_t* m_xdp;
+
+  // Native code buffer; enter/leave code, start of word code and
+  // allocation pointer
+  uint8_t* m_jit;
+  uint8_t* m_jp0;
+  uint8_t* m_jp;
+
+  // Dynamic dictionary hash index; open addressing with word index
+  // plus one (zero for empty)
+  static const int INDEX_MAX = 256;
+  uint8_t m_index[INDEX_MAX];
+
+  /**
+   * Add given dynamic dictionary word to hash index. A name that is
+   * already in the index is not added; lookup finds the first
+   * definition.
+   * @param[in] nr index in dynamic dictionary.
+   */
+  void index_name(uint8_t nr);
+
+  /**
+   * Rebuild hash index for dynamic dictionary words.
+   */
+  void index_names()
+  {
+    memset(m_index, 0, sizeof(m_index));
+    for (int i = 0; i < m_next; i++) index_name(i);
+  }
+
+  /**
+   * Return name of given sketch or kernel token.
+   * @param[in] token sketch or kernel token.
+   * @return name.
+   */
+  static const char* lookup_name(int token);
+
+  /**
+   * Add given sketch or kernel token to the static hash index.
+   * @param[in] token sketch or kernel token.
+   */
+  static void lookup_index(int token);
+
+  /**
+   * Release all pre-decoded and native code. Words are translated
+   * again on next call.
+   */
+  void forget_xcode()
+  {
+    uintptr_t end = (uintptr_t) m_line;
+    m_xdp = (xcode_t*) (end & ~(sizeof(xcode_t) - 1));
+    for (int i = 0; i < WORD_MAX; i++) m_xcode[i] = 0;
+    m_jp = m_jp0;
+  }
+
+  /**
+   * Translate given dynamic dictionary word to pre-decoded code with
+   * given handler address table. Return true if translated otherwise
+   * false; the word is then executed as threaded code.
+   * @param[in] nr index in dynamic dictionary.
+   * @param[in] xtab handler address table.
+   * @return bool.
+   */
+  bool translate(uint8_t nr, const void* const* xtab);
+
+  /**
+   * Decode token at given threaded code pointer in word body to
+   * pre-decoded code. Count only when given pre-decoded code pointer
+   * is null. Return number of pre-decoded code elements or negative
+   * error code(-1) if the token may not be translated.
+   * @param[in,out] ip threaded code pointer.
+   * @param[in] nr index in dynamic dictionary.
+   * @param[in] xp pre-decoded code pointer (or null).
+   * @param[in] xtab handler address table.
+   * @return number of elements or negative error code.
+   */
+  int decode(code_P& ip, uint8_t nr, xcode_t* xp, const void* const* xtab);
+
+  /**
+   * Compile given translated word to native code. Elements that are
+   * not compiled (calls and kernel operations) return to the inner
+   * interpreter and continue in native code. Return true if compiled
+   * otherwise false; the word is then executed as pre-decoded code.
+   * @param[in] nr index in dynamic dictionary.
+   * @param[in] n number of pre-decoded code elements.
+   * @param[in] xtab handler address table.
+   * @return bool.
+   */
+  bool jit(uint8_t nr, int n, const void* const* xtab);
+
+  /**
+   * Print name of given token; kernel, application or dynamic
+   * dictionary word. Nothing is printed if the name is not available.
+   * @param[in] ios output stream.
+   * @param[in] token to print.
+   */
+  void print_name(Stream& ios, int token);
+
+  /**
+   * Print call path of given call graph node; word names from root
+   * separated by semicolon.
+   * @param[in] ios output stream.
+   * @param[in] node index.
+   */
+  void print_path(Stream& ios, int node);
+#endif
+
+  /**
+   * Execute given rarely used kernel operation (room, lookup, words,
+   * .s, .name, pinmode and profile) out of line from the inner
+   * interpreter. The parameter stack is spilled to the task.
+   * @param[in] op operation code.
+   * @param[in] task to execute.
+   * @param[in] out task output.
+   */
+  void cold(uint8_t op, task_t& task, Print& out)
+    __attribute__((noinline));
+
+  /**
+   * Inner interpreter with (TRACE) or without trace. Resume given
+   * task. Return yield(1), halt(0), trace mode changed(2) or error
+   * code(-1).
+   * @param[in] task to resume.
+   * @return error code.
+   */
+  template<bool TRACE> int inner(task_t& task, uint32_t budget);
 };
 
 /**
@@ -654,6 +1439,27 @@ class FVM {
  */
 #define FVM_OP(code) FVM::OP_ ## code
 
+/**
+ * Compile extended virtual machine instruction (128..255).
+ * @param[in] code operation code.
+ */
+#define FVM_SYSCALL(code)						\
+  FVM::OP_SYSCALL,							\
+  FVM::code_t(FVM::OP_ ## code)
+
+/**
+ * Compile branch instruction with long offset (16-bit,
+ * -32768..32767). The branch operation code (BRANCH, ZERO_BRANCH,
+ * DO, LOOP, PLUS_LOOP, FOR, NEXT) is prefixed with OP_SYSCALL.
+ * @param[in] code branch operation code.
+ * @param[in] n offset.
+ */
+#define FVM_LONG(code,n)						\
+  FVM::OP_SYSCALL,							\
+  FVM::OP_ ## code,							\
+  FVM::code_t(n),							\
+  FVM::code_t((n) >> 8)
+
 /**
  * Compile literal number (little endian).
  * @param[in] n number.
@@ -663,6 +1469,35 @@ class FVM {
   FVM::code_t(n),							\
   FVM::code_t((n) >> 8)
 
+/**
+ * Compile cell width literal number (little endian, FVM_CELL).
+ * @param[in] n number.
+ */
+#if (FVM_CELL == 16)
+#define FVM_WLIT(n)							\
+  FVM::OP_WLIT,								\
+  FVM::code_t(n),							\
+  FVM::code_t((n) >> 8)
+#elif (FVM_CELL == 32)
+#define FVM_WLIT(n)							\
+  FVM::OP_WLIT,								\
+  FVM::code_t(n),							\
+  FVM::code_t((n) >> 8),						\
+  FVM::code_t((n) >> 16),						\
+  FVM::code_t((n) >> 24)
+#else
+#define FVM_WLIT(n)							\
+  FVM::OP_WLIT,								\
+  FVM::code_t(n),							\
+  FVM::code_t((n) >> 8),						\
+  FVM::code_t((n) >> 16),						\
+  FVM::code_t((n) >> 24),						\
+  FVM::code_t((int64_t) (n) >> 32),					\
+  FVM::code_t((int64_t) (n) >> 40),					\
+  FVM::code_t((int64_t) (n) >> 48),					\
+  FVM::code_t((int64_t) (n) >> 56)
+#endif
+
 /**
  * Compile literal number (-128..127) or character (0..255).
  * @param[in] n number.
@@ -690,7 +1525,7 @@ class FVM {
   const FVM::obj_t var ## _VAR PROGMEM = {				\
     FVM_CALL(does),							\
     FVM_OP(NOOP),							\
-    (FVM::cell_t*) &data						\
+    FVM_ADDRESS(&data)							\
   }
 
 /**
@@ -704,7 +1539,7 @@ class FVM {
   const char var ## _PSTR[] PROGMEM = #data;				\
   const FVM::var_t var ## _VAR PROGMEM = {				\
     FVM_OP(CONST),							\
-    (FVM::cell_t*) &data						\
+    FVM_ADDRESS(&data)							\
   }
 
 /**